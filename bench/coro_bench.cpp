@@ -0,0 +1,51 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include "../inc/frame_pool.h"
+#include "../inc/task.h"
+
+/**
+ * @brief Задача, выполняемая на каждый запрос: один кадр сопрограммы.
+ */
+template <typename Pool>
+custom::task<long, Pool> handle(long request) {
+  co_return request * 2;
+}
+
+/**
+ * @brief Обработка count запросов, каждый - отдельная сопрограмма.
+ */
+template <typename Pool>
+custom::task<long, Pool> serve(long count) {
+  long sum = 0;
+  for(long i = 0; i < count; ++i)
+    sum += co_await handle<Pool>(i);
+  co_return sum;
+}
+
+/**
+ * @brief Замер времени на один кадр сопрограммы с пулом Pool.
+ * @return false, если результат вычислен неверно.
+ */
+template <typename Pool>
+bool run(const char* name, long count) {
+  auto start = std::chrono::steady_clock::now();
+  long sum = serve<Pool>(count).get();
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  double ns = std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(count);
+  std::cout << name << ": " << ns << " ns/frame" << std::endl;
+  return sum == count * (count - 1);
+}
+
+int main(int argc, char* argv[])
+{
+  long count = argc > 1 ? std::atol(argv[1]) : 1000000;
+
+  bool ok = run<custom::global_frame_pool>("global operator new", count);
+  ok = run<custom::frame_pool>("frame_pool", count) && ok;
+  ok = run<custom::fixed_frame_pool<256, 16>>("fixed_frame_pool", count) && ok;
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,477 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+
+#include "custom_vector.h"
+
+namespace custom {
+/**
+ * @brief Вектор, допускающий одновременное добавление элементов из нескольких потоков.
+ *
+ * Элементы хранятся в сегментах, размер которых удваивается: сегмент 0 вмещает
+ * FIRST_SEGMENT_SIZE элементов, сегмент k > 0 - FIRST_SEGMENT_SIZE << (k - 1). Сегменты
+ * не перемещаются, поэтому адреса элементов остаются верными при росте вектора.
+ * Индексы под элементы выделяются атомарным счетчиком после создания сегментов под них,
+ * а сегменты создаются под мьютексом вектора, чтобы два потока не выделили один сегмент
+ * дважды (это происходит O(log n) раз). За каждым сегментом хранятся состояния ячеек:
+ * size() учитывает только непрерывный префикс завершенных ячеек, а clear() удаляет
+ * только созданные элементы. Если создание элемента завершилось исключением, его индекс
+ * возвращается, когда после него индексы еще не выданы; иначе ячейка помечается удаленной:
+ * size() ее учитывает, итераторы пропускают, а at() выбрасывает исключение.
+ * Удаление и clear() не допускают одновременной работы.
+ */
+template <typename T, typename A = std::allocator<T>>
+class concurrent_vector {
+  public:
+    using size_type = size_t;
+    using value_type = T;
+    using allocator_type = A;
+    using difference_type = ptrdiff_t;
+    using reference = T&;
+    using const_reference = const T&;
+
+    ///< Размер первого сегмента, степень двойки.
+    static constexpr size_type FIRST_SEGMENT_SIZE = 8;
+
+    /**
+     * @brief Итератор произвольного доступа по индексу элемента.
+     */
+    template <typename U>
+    struct iterator_base {
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = typename std::remove_const<U>::type;
+        using difference_type = ptrdiff_t;
+        using pointer = U*;
+        using reference = U&;
+        using owner_type = typename std::conditional<std::is_const<U>::value,
+                                                     const concurrent_vector, concurrent_vector>::type;
+
+        iterator_base() : owner_(nullptr), index_(0) {}
+
+        iterator_base(owner_type* owner, size_type index) : owner_(owner), index_(index) {}
+
+        template <typename V, typename = typename std::enable_if<std::is_convertible<V*, U*>::value>::type>
+        iterator_base(const iterator_base<V>& other) : owner_(other.owner()), index_(other.index()) {}
+
+        iterator_base& operator ++() {
+          // Удаленные ячейки пропускаются.
+          while((++index_ < owner_->size()) && owner_->isBroken(index_))
+            ;
+          return *this;
+        }
+
+        iterator_base operator ++(int) {
+          iterator_base temp = *this;
+          ++*this;
+          return temp;
+        }
+
+        iterator_base& operator --() {
+          while((--index_ > 0) && owner_->isBroken(index_))
+            ;
+          return *this;
+        }
+
+        iterator_base operator --(int) {
+          iterator_base temp = *this;
+          --*this;
+          return temp;
+        }
+
+        iterator_base& operator += (difference_type n) {
+          index_ += n;
+          return *this;
+        }
+
+        iterator_base& operator -= (difference_type n) {
+          index_ -= n;
+          return *this;
+        }
+
+        iterator_base operator + (difference_type n) const {
+          return iterator_base(owner_, index_ + n);
+        }
+
+        friend iterator_base operator + (difference_type n, const iterator_base& it) {
+          return it + n;
+        }
+
+        iterator_base operator - (difference_type n) const {
+          return iterator_base(owner_, index_ - n);
+        }
+
+        difference_type operator - (const iterator_base& other) const {
+          return static_cast<difference_type>(index_) - static_cast<difference_type>(other.index_);
+        }
+
+        reference operator *() const {
+          return (*owner_)[index_];
+        }
+
+        pointer operator ->() const {
+          return &(*owner_)[index_];
+        }
+
+        reference operator [](difference_type n) const {
+          return (*owner_)[index_ + n];
+        }
+
+        bool operator == (const iterator_base& other) const {
+          return index_ == other.index_;
+        }
+
+        bool operator != (const iterator_base& other) const {
+          return !(*this == other);
+        }
+
+        bool operator < (const iterator_base& other) const {
+          return index_ < other.index_;
+        }
+
+        bool operator > (const iterator_base& other) const {
+          return other < *this;
+        }
+
+        bool operator <= (const iterator_base& other) const {
+          return !(other < *this);
+        }
+
+        bool operator >= (const iterator_base& other) const {
+          return !(*this < other);
+        }
+
+        owner_type* owner() const {
+          return owner_;
+        }
+
+        size_type index() const {
+          return index_;
+        }
+
+      private:
+        owner_type* owner_;
+        size_type index_;
+    };
+
+    using iterator = iterator_base<T>;
+    using const_iterator = iterator_base<const T>;
+
+    concurrent_vector() : reserved_(0), size_(0) {
+      for(auto& segment: segments_)
+        segment.store(nullptr, std::memory_order_relaxed);
+    }
+
+    concurrent_vector(const concurrent_vector&) = delete;
+
+    concurrent_vector& operator = (const concurrent_vector&) = delete;
+
+    ~concurrent_vector() {
+      clear();
+    }
+
+    /**
+     * @brief Добавление элемента, допускает одновременный вызов из нескольких потоков.
+     * @return итератор на добавленный элемент.
+     */
+    iterator push_back(const T& value) {
+      return append(1, [this, &value](T* ptr) { allocator_->construct(ptr, value); });
+    }
+
+    /**
+     * @brief Добавление count элементов, созданных по умолчанию, одним непрерывным диапазоном индексов.
+     * @return итератор на первый добавленный элемент.
+     */
+    iterator grow_by(size_type count) {
+      return append(count, [this](T* ptr) { allocator_->construct(ptr); });
+    }
+
+    /**
+     * @brief Добавление count копий value одним непрерывным диапазоном индексов.
+     * @return итератор на первый добавленный элемент.
+     */
+    iterator grow_by(size_type count, const T& value) {
+      return append(count, [this, &value](T* ptr) { allocator_->construct(ptr, value); });
+    }
+
+    /**
+     * @brief Выделение сегментов под capacity элементов заранее.
+     */
+    void reserve(size_type capacity) {
+      if(capacity > 0)
+        for(size_type segment = 0; segment <= segmentOf(capacity - 1); ++segment)
+          segmentAt(segment);
+    }
+
+    /**
+     * @brief Выдать количество ячеек в непрерывном префиксе завершенных ячеек (с удаленными).
+     */
+    size_type size() const {
+      return size_.load(std::memory_order_acquire);
+    }
+
+    bool empty() const {
+      return size() == 0;
+    }
+
+    /**
+     * @brief Выдать количество элементов, под которые выделены сегменты.
+     */
+    size_type capacity() const {
+      size_type capacity = 0;
+      for(size_type segment = 0; segment < SEGMENTS; ++segment) {
+        if(segments_[segment].load(std::memory_order_acquire) == nullptr)
+          break;
+        capacity = segmentBase(segment) + segmentSize(segment);
+      }
+      return capacity;
+    }
+
+    /**
+     * @brief Удаление всех элементов и сегментов, не допускает одновременной работы с вектором.
+     */
+    void clear() {
+      for(size_type segment = 0; segment < SEGMENTS; ++segment) {
+        T* data = segments_[segment].exchange(nullptr, std::memory_order_relaxed);
+        if(data == nullptr)
+          continue;
+
+        std::atomic<uint8_t>* states = segmentStates(data, segment);
+        for(size_type i = 0; i < segmentSize(segment); ++i)
+          if(states[i].load(std::memory_order_relaxed) == SLOT_CONSTRUCTED)
+            allocator_->destroy(data + i);
+        allocator_->deallocate(data, segmentBlockSize(segment));
+      }
+      reserved_.store(0, std::memory_order_relaxed);
+      size_.store(0, std::memory_order_relaxed);
+    }
+
+    T& operator [] (size_type pos) {
+      size_type segment = segmentOf(pos);
+      return segments_[segment].load(std::memory_order_acquire)[pos - segmentBase(segment)];
+    }
+
+    const T& operator [] (size_type pos) const {
+      size_type segment = segmentOf(pos);
+      return segments_[segment].load(std::memory_order_acquire)[pos - segmentBase(segment)];
+    }
+
+    T& at(size_type pos) {
+      if ((pos >= size()) || isBroken(pos))
+        throw std::out_of_range("Out of scope");
+      else
+        return (*this)[pos];
+    }
+
+    const T& at(size_type pos) const {
+      if ((pos >= size()) || isBroken(pos))
+        throw std::out_of_range("Out of scope");
+      else
+        return (*this)[pos];
+    }
+
+    iterator begin() {
+      return iterator(this, firstElement());
+    }
+
+    iterator end() {
+      return iterator(this, size());
+    }
+
+    const_iterator begin() const {
+      return const_iterator(this, firstElement());
+    }
+
+    const_iterator end() const {
+      return const_iterator(this, size());
+    }
+
+    const_iterator cbegin() const {
+      return begin();
+    }
+
+    const_iterator cend() const {
+      return end();
+    }
+
+  private:
+    ///< Количество сегментов, достаточное для адресации size_t элементов.
+    static constexpr size_type SEGMENTS = sizeof(size_type) * 8;
+
+    ///< Состояние ячейки: элемент не создан.
+    static constexpr uint8_t SLOT_EMPTY = 0;
+
+    ///< Состояние ячейки: элемент создан.
+    static constexpr uint8_t SLOT_CONSTRUCTED = 1;
+
+    ///< Состояние ячейки: создание элемента завершилось исключением, ячейка удалена.
+    static constexpr uint8_t SLOT_BROKEN = 2;
+
+    ///< Количество выданных индексов.
+    std::atomic<size_type> reserved_;
+
+    ///< Длина непрерывного префикса созданных элементов.
+    std::atomic<size_type> size_;
+
+    std::atomic<T*> segments_[SEGMENTS];
+
+    ///< Мьютекс выделения сегментов.
+    std::mutex segmentMutex_;
+
+    detail::allocator_holder<allocator_type> allocator_;
+
+    static size_type segmentOf(size_type index) {
+      if(index < FIRST_SEGMENT_SIZE)
+        return 0;
+      return sizeof(unsigned long long) * 8 - static_cast<size_type>(__builtin_clzll(index / FIRST_SEGMENT_SIZE));
+    }
+
+    static size_type segmentBase(size_type segment) {
+      return segment == 0 ? 0 : FIRST_SEGMENT_SIZE << (segment - 1);
+    }
+
+    static size_type segmentSize(size_type segment) {
+      return segment == 0 ? FIRST_SEGMENT_SIZE : FIRST_SEGMENT_SIZE << (segment - 1);
+    }
+
+    /**
+     * @brief Размер блока сегмента в элементах: ячейки и следующие за ними признаки состояния.
+     */
+    static size_type segmentBlockSize(size_type segment) {
+      size_type size = segmentSize(segment);
+      return size + (size * sizeof(std::atomic<uint8_t>) + sizeof(T) - 1) / sizeof(T);
+    }
+
+    /**
+     * @brief Признаки состояния ячеек сегмента.
+     */
+    static std::atomic<uint8_t>* segmentStates(T* data, size_type segment) {
+      return reinterpret_cast<std::atomic<uint8_t>*>(data + segmentSize(segment));
+    }
+
+    /**
+     * @brief Выдать сегмент, при необходимости выделив его.
+     */
+    T* segmentAt(size_type segment) {
+      T* data = segments_[segment].load(std::memory_order_acquire);
+      if(data == nullptr) {
+        std::lock_guard<std::mutex> lock(segmentMutex_);
+        data = segments_[segment].load(std::memory_order_relaxed);
+        if(data == nullptr) {
+          data = detail::to_address(allocator_->allocate(segmentBlockSize(segment)));
+          std::atomic<uint8_t>* states = segmentStates(data, segment);
+          for(size_type i = 0; i < segmentSize(segment); ++i)
+            ::new (static_cast<void*>(states + i)) std::atomic<uint8_t>(SLOT_EMPTY);
+          segments_[segment].store(data, std::memory_order_release);
+        }
+      }
+      return data;
+    }
+
+    /**
+     * @brief Адрес ячейки под элемент с индексом index.
+     */
+    T* slot(size_type index) {
+      size_type segment = segmentOf(index);
+      return segmentAt(segment) + (index - segmentBase(segment));
+    }
+
+    /**
+     * @brief Выдать состояние ячейки с индексом index (SLOT_EMPTY, если сегмента нет).
+     */
+    uint8_t stateOf(size_type index) const {
+      size_type segment = segmentOf(index);
+      T* data = segments_[segment].load(std::memory_order_acquire);
+      return (data != nullptr) ? segmentStates(data, segment)[index - segmentBase(segment)].load() : SLOT_EMPTY;
+    }
+
+    /**
+     * @brief Проверка, что ячейка с индексом index удалена.
+     */
+    bool isBroken(size_type index) const {
+      return stateOf(index) == SLOT_BROKEN;
+    }
+
+    /**
+     * @brief Выдать индекс первого неудаленного элемента (или size()).
+     */
+    size_type firstElement() const {
+      size_type index = 0;
+      while((index < size()) && isBroken(index))
+        ++index;
+      return index;
+    }
+
+    /**
+     * @brief Запись состояния ячеек [first, first + count), сегменты под них уже созданы.
+     */
+    void markSlots(size_type first, size_type count, uint8_t state) {
+      for(size_type i = first; i < first + count; ++i) {
+        size_type segment = segmentOf(i);
+        segmentStates(segments_[segment].load(std::memory_order_relaxed), segment)[i - segmentBase(segment)].store(state);
+      }
+    }
+
+    /**
+     * @brief Добавление count элементов: выдача индексов, создание элементов и их публикация.
+     * @param construct - создание элемента в ячейке.
+     * @return итератор на первый добавленный элемент.
+     */
+    template <typename F>
+    iterator append(size_type count, F construct) {
+      if(count == 0)
+        return iterator(this, reserved_.load(std::memory_order_relaxed));
+
+      // Индексы выдаются только под созданные сегменты, поэтому после выдачи
+      // исключение возможно лишь при создании элемента, и ячейку можно пометить удаленной.
+      size_type first = reserved_.load(std::memory_order_relaxed);
+      do {
+        for(size_type segment = segmentOf(first); segment <= segmentOf(first + count - 1); ++segment)
+          segmentAt(segment);
+      } while(!reserved_.compare_exchange_weak(first, first + count, std::memory_order_relaxed));
+
+      size_type i = first;
+      try {
+        for(; i < first + count; ++i)
+          construct(slot(i));
+      }
+      catch(...) {
+        while(i > first)
+          allocator_->destroy(slot(--i));
+        // Индексы возвращаются, только если после них еще ничего не выдано.
+        size_type end = first + count;
+        if(!reserved_.compare_exchange_strong(end, first, std::memory_order_relaxed)) {
+          markSlots(first, count, SLOT_BROKEN);
+          publish();
+        }
+        throw;
+      }
+
+      markSlots(first, count, SLOT_CONSTRUCTED);
+      publish();
+      return iterator(this, first);
+    }
+
+    /**
+     * @brief Продвижение size_ по завершенным (созданным или удаленным) ячейкам.
+     *
+     * Состояние ячейки записывается до чтения size_, поэтому из двух потоков, завершивших
+     * соседние ячейки, хотя бы один увидит оба состояния и продвинет size_ дальше.
+     */
+    void publish() {
+      size_type size = size_.load();
+      while(stateOf(size) != SLOT_EMPTY) {
+        if(size_.compare_exchange_weak(size, size + 1))
+          ++size;
+      }
+    }
+};
+
+}
@@ -2,8 +2,11 @@
 
 #include <algorithm>
 #include <array>
+#include <memory>
+#include <type_traits>
 
 #include "custom_heap.h"
+#include "heap_profiler.h"
 
 namespace custom {
 /**
@@ -31,19 +34,85 @@ class allocator
       other.swap(*this);
     }
 
-    pointer allocate(size_type n, const void* = 0) {
+    CUSTOM_PROFILED pointer allocate(size_type n, const void* = 0) {
       auto ptr = takeBlock(n);
       if(ptr == nullptr)
         throw std::bad_alloc();
+      profiler::recordAlloc(ptr, n * sizeof(T));
+      return ptr;
+    }
+
+    CUSTOM_PROFILED pointer try_allocate(size_type n) noexcept {
+      auto ptr = takeBlock(n);
+      if(ptr != nullptr)
+        profiler::recordAlloc(ptr, n * sizeof(T));
       return ptr;
     }
 
+    bool owns(const void* ptr) const {
+      auto bytePtr = static_cast<const uint8_t*>(ptr);
+      return (bytePtr >= data_.data()) && (bytePtr < data_.data() + data_.size());
+    }
+
     void deallocate(void* ptr, size_type n) {
       if (ptr) {
+        profiler::recordFree(ptr);
         releaseBlock(static_cast<pointer>(ptr), n);
       }
     }
 
+    CUSTOM_PROFILED void allocate_bulk(size_type n, size_type count, pointer* out) {
+      auto done = takeBlocks(n, count, out);
+      if(done != count) {
+        for(size_type i = 0; i < done; ++i)
+          releaseBlock(out[i], n);
+        throw std::bad_alloc();
+      }
+      for(size_type i = 0; i < count; ++i)
+        profiler::recordAlloc(out[i], n * sizeof(T));
+    }
+
+    void deallocate_bulk(pointer* ptrs, size_type count, size_type n) {
+      // Соседние блоки (как их выдает allocate_bulk) снимаются с карты одним диапазоном.
+      size_type first = 0;
+      for(size_type i = 0; i < count; ++i) {
+        if(ptrs[i] == nullptr) {
+          first = i + 1;
+          continue;
+        }
+
+        profiler::recordFree(ptrs[i]);
+        if((i + 1 == count) || (ptrs[i + 1] != ptrs[i] + n)) {
+          releaseBlock(ptrs[first], n * (i + 1 - first));
+          first = i + 1;
+        }
+      }
+    }
+
+    /**
+     * @brief Расширение блока на месте, если следующие за ним элементы свободны.
+     * @param ptr - указатель на блок.
+     * @param n - текущий размер блока в элементах.
+     * @param newN - требуемый размер блока в элементах.
+     * @return true, если блок расширен.
+     */
+    bool try_expand(pointer ptr, size_type n, size_type newN) noexcept {
+      if(!owns(ptr))
+        return false;
+
+      auto pos = static_cast<size_t>(ptr - reinterpret_cast<pointer>(&data_[0]));
+      if((newN <= n) || (pos + newN > N))
+        return false;
+
+      auto first = flags_.begin() + pos + n;
+      auto last  = flags_.begin() + pos + newN;
+      if(std::find(first, last, true) != last)
+        return false;
+
+      std::fill(first, last, true);
+      return true;
+    }
+
     pointer address(reference ref) const {
       return &ref;
     }
@@ -81,7 +150,11 @@ class allocator
     }
 
     size_type max_size() const {
-      return size_t(-1);
+      return N;
+    }
+
+    size_type usable_size(pointer, size_type n) const {
+      return n;
     }
 
     template <class U>
@@ -122,9 +195,31 @@ class allocator
       return nullptr;
     }
 
+    size_t takeBlocks(size_t n, size_t count, pointer* out) {
+      auto first = flags_.begin();
+      size_t cnt = 0;
+      size_t done = 0;
+      for(auto it = flags_.begin(); (it != flags_.end()) && (done < count); ++it) {
+        if(!(*it)) {
+          if(cnt == 0)
+            first = it;
+
+          if(++cnt == n) {
+            std::fill(first, it + 1, true);
+            auto pos = static_cast<size_t>(std::distance(flags_.begin(), first));
+            out[done++] = reinterpret_cast<pointer>(&data_[sizeof(value_type) * pos]);
+            cnt = 0;
+          }
+        }
+        else
+          cnt = 0;
+      }
+      return done;
+    }
+
     void releaseBlock(pointer ptr, size_t n) {
       int pos = ptr - reinterpret_cast<pointer>(&data_[0]);
-      if(pos >= 0 && pos + static_cast<int>(n) < static_cast<int>(N)) {
+      if(pos >= 0 && pos + static_cast<int>(n) <= static_cast<int>(N)) {
         auto first = flags_.begin() + pos;
         auto last  = first + static_cast<int>(n);
         std::fill(first, last, false);
@@ -162,13 +257,46 @@ class allocator<T, 0>
     allocator(const allocator&&) {}
 
     pointer allocate(size_type n, const void* = 0) {
-      T* ptr = reinterpret_cast<T*>(custom::malloc(n * sizeof(T)));
+      auto ptr = try_allocate(n);
+      if(ptr == nullptr)
+        throw std::bad_alloc();
       return ptr;
     }
 
-    void deallocate(void* ptr, size_type) {
+    pointer try_allocate(size_type n) noexcept {
+      return reinterpret_cast<T*>(custom::malloc(n * sizeof(T)));
+    }
+
+    void deallocate(void* ptr, size_type n) {
       if (ptr) {
-        custom::free(ptr);
+        custom::free_sized(ptr, n * sizeof(T));
+      }
+    }
+
+    void allocate_bulk(size_type n, size_type count, pointer* out) {
+      void* chunk[BULK_CHUNK];
+      for(size_type done = 0; done < count;) {
+        size_type part = (count - done < BULK_CHUNK) ? count - done : BULK_CHUNK;
+        size_type taken = custom::malloc_batch(n * sizeof(T), part, chunk);
+        for(size_type i = 0; i < taken; ++i)
+          out[done + i] = static_cast<pointer>(chunk[i]);
+        done += taken;
+
+        if(taken != part) {
+          deallocate_bulk(out, done, n);
+          throw std::bad_alloc();
+        }
+      }
+    }
+
+    void deallocate_bulk(pointer* ptrs, size_type count, size_type) {
+      void* chunk[BULK_CHUNK];
+      for(size_type done = 0; done < count;) {
+        size_type part = (count - done < BULK_CHUNK) ? count - done : BULK_CHUNK;
+        for(size_type i = 0; i < part; ++i)
+          chunk[i] = ptrs[done + i];
+        custom::free_batch(chunk, part);
+        done += part;
       }
     }
 
@@ -208,7 +336,11 @@ class allocator<T, 0>
     }
 
     size_type max_size() const {
-      return size_t(-1);
+      return custom::getHeapSize() / sizeof(T);
+    }
+
+    size_type usable_size(pointer ptr, size_type) const {
+      return custom::getUsableSize(ptr) / sizeof(T);
     }
 
     template <class U>
@@ -223,6 +355,201 @@ class allocator<T, 0>
     allocator& operator = (const allocator<U, 0>&) {
       return *this;
     }
+
+  private:
+    ///< Количество указателей, передаваемых в кучу за один пакетный вызов.
+    static constexpr size_type BULK_CHUNK = 128;
+};
+
+/**
+ * @brief Составной аллокатор: память выделяется из Primary, а при его исчерпании - из Secondary.
+ *
+ * Primary должен предоставлять try_allocate() и owns() (например, allocator<T, N>),
+ * Secondary - любой аллокатор того же типа элементов (allocator<T, 0>, std::allocator<T>).
+ */
+template <typename Primary, typename Secondary>
+class fallback
+{
+  public:
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+    using pointer = typename Primary::pointer;
+    using const_pointer = typename Primary::const_pointer;
+    using reference = typename Primary::reference;
+    using const_reference = typename Primary::const_reference;
+    using value_type = typename Primary::value_type;
+
+    static_assert(std::is_same<value_type, typename Secondary::value_type>::value,
+                  "Composed allocators must have the same value type");
+
+    fallback() {}
+
+    ~fallback() {}
+
+    template <typename P, typename S>
+    fallback(const fallback<P, S>& other) : primary_(other.primary()), secondary_(other.secondary()) {}
+
+    pointer allocate(size_type n, const void* = 0) {
+      auto ptr = primary_.try_allocate(n);
+      if(ptr == nullptr)
+        ptr = secondary_.allocate(n);
+      return ptr;
+    }
+
+    pointer try_allocate(size_type n) noexcept {
+      try {
+        return allocate(n);
+      }
+      catch(const std::bad_alloc&) {
+        return nullptr;
+      }
+    }
+
+    void deallocate(void* ptr, size_type n) {
+      if(primary_.owns(ptr))
+        primary_.deallocate(ptr, n);
+      else
+        secondary_.deallocate(static_cast<pointer>(ptr), n);
+    }
+
+    bool owns(const void* ptr) const {
+      return primary_.owns(ptr);
+    }
+
+    bool operator != (const fallback&) {
+      return true;
+    }
+
+    bool operator == (const fallback&) {
+      return false;
+    }
+
+    template<typename U, typename ...Args>
+    void construct(U* ptr, Args &&...args) {
+      new(ptr) U(std::forward<Args>(args)...);
+    }
+
+    void destroy(pointer ptr) {
+      ptr->~value_type();
+    }
+
+    size_type max_size() const {
+      return std::max<size_type>(std::allocator_traits<Primary>::max_size(primary_),
+                                 std::allocator_traits<Secondary>::max_size(secondary_));
+    }
+
+    template <class U>
+    struct rebind {
+        using other = fallback<typename std::allocator_traits<Primary>::template rebind_alloc<U>,
+                               typename std::allocator_traits<Secondary>::template rebind_alloc<U>>;
+    };
+
+    const Primary& primary() const {
+      return primary_;
+    }
+
+    const Secondary& secondary() const {
+      return secondary_;
+    }
+
+  private:
+    Primary primary_;
+    Secondary secondary_;
+};
+
+/**
+ * @brief Составной аллокатор: запросы размером до Threshold байт обслуживает Small, остальные - Large.
+ *
+ * Освобождение направляется по тому же размеру, поэтому владелец блока не ищется.
+ */
+template <size_t Threshold, typename Small, typename Large>
+class segregator
+{
+  public:
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+    using pointer = typename Small::pointer;
+    using const_pointer = typename Small::const_pointer;
+    using reference = typename Small::reference;
+    using const_reference = typename Small::const_reference;
+    using value_type = typename Small::value_type;
+
+    static_assert(std::is_same<value_type, typename Large::value_type>::value,
+                  "Composed allocators must have the same value type");
+
+    segregator() {}
+
+    ~segregator() {}
+
+    template <typename S, typename L>
+    segregator(const segregator<Threshold, S, L>& other) : small_(other.small()), large_(other.large()) {}
+
+    pointer allocate(size_type n, const void* = 0) {
+      if(isSmall(n))
+        return small_.allocate(n);
+      else
+        return large_.allocate(n);
+    }
+
+    pointer try_allocate(size_type n) noexcept {
+      try {
+        return allocate(n);
+      }
+      catch(const std::bad_alloc&) {
+        return nullptr;
+      }
+    }
+
+    void deallocate(void* ptr, size_type n) {
+      if(isSmall(n))
+        small_.deallocate(static_cast<pointer>(ptr), n);
+      else
+        large_.deallocate(static_cast<pointer>(ptr), n);
+    }
+
+    bool operator != (const segregator&) {
+      return true;
+    }
+
+    bool operator == (const segregator&) {
+      return false;
+    }
+
+    template<typename U, typename ...Args>
+    void construct(U* ptr, Args &&...args) {
+      new(ptr) U(std::forward<Args>(args)...);
+    }
+
+    void destroy(pointer ptr) {
+      ptr->~value_type();
+    }
+
+    size_type max_size() const {
+      return std::allocator_traits<Large>::max_size(large_);
+    }
+
+    template <class U>
+    struct rebind {
+        using other = segregator<Threshold,
+                                 typename std::allocator_traits<Small>::template rebind_alloc<U>,
+                                 typename std::allocator_traits<Large>::template rebind_alloc<U>>;
+    };
+
+    const Small& small() const {
+      return small_;
+    }
+
+    const Large& large() const {
+      return large_;
+    }
+
+  private:
+    Small small_;
+    Large large_;
+
+    static bool isSmall(size_type n) {
+      return n * sizeof(value_type) <= Threshold;
+    }
 };
 
 }
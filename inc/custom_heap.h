@@ -2,6 +2,10 @@
 
 #include <stddef.h>
 
+/**
+ * Все функции кучи потокобезопасны: доступ к куче сериализуется одним мьютексом,
+ * общим для всех ее пользователей.
+ */
 namespace  custom {
 ///< Размер кучи, байт.
 static constexpr size_t HEAP_SIZE = 65536;
@@ -15,13 +19,96 @@ void* malloc(size_t size);
 
 /**
  * @brief Освобождение памяти в куче.
+ *
+ * Блок возвращается в ту кучу (в памяти процесса или в файле), из которой он выделен,
+ * указатель, не принадлежащий ни одной из них, игнорируется.
  * @param ptr - указатель на удаляемый блок памяти.
  */
 void free(void* ptr);
 
+/**
+ * @brief Освобождение памяти в куче с известным размером блока.
+ * @param ptr - указатель на удаляемый блок памяти.
+ * @param size - размер, с которым блок был выделен.
+ */
+void free_sized(void* ptr, size_t size);
+
+/**
+ * @brief Выделение нескольких блоков одного размера за один проход по свободной памяти.
+ * @param size - размер каждого блока.
+ * @param count - количество блоков.
+ * @param out - массив, куда записываются указатели на выделенные блоки.
+ * @return количество выделенных блоков (меньше count, если памяти не хватило).
+ */
+size_t malloc_batch(size_t size, size_t count, void** out);
+
+/**
+ * @brief Освобождение нескольких блоков за один проход по списку свободных.
+ * @param ptrs - массив указателей на удаляемые блоки (не изменяется).
+ * @param count - количество блоков.
+ */
+void free_batch(void* const* ptrs, size_t count);
+
+/**
+ * @brief Выдать реальный размер выделенного блока, доступный для использования.
+ * @param ptr - указатель на выделенный блок памяти.
+ * @return размер блока без служебной информации, байт.
+ */
+size_t getUsableSize(void* ptr);
+
 /**
  * @brief Выдать размер свободной памяти в куче, без учета фрагментации.
  * @return размер свободной памяти в куче.
  */
 size_t getFreeHeapSize();
+
+/**
+ * @brief Проверка, выделен ли блок из текущей кучи.
+ * @param ptr - указатель на блок памяти.
+ * @return true, если указатель принадлежит текущей куче.
+ */
+bool isHeapPointer(const void* ptr);
+
+/**
+ * @brief Выдать размер текущей кучи.
+ * @return размер кучи, байт.
+ */
+size_t getHeapSize();
+
+/**
+ * @brief Размещение кучи в файле, отображенном в память.
+ *
+ * Новый файл размечается как пустая куча, существующий открывается вместе с ранее
+ * выделенными блоками. Служебные структуры кучи хранят смещения, а сам файл
+ * отображается по адресу, на котором он был создан, поэтому указатели внутри кучи
+ * остаются верными. Блоки, выделенные до переключения, при освобождении
+ * возвращаются в кучу в памяти процесса.
+ * @param path - путь к файлу кучи.
+ * @param size - размер кучи при создании нового файла.
+ * @return true, если куча переключена на файл.
+ */
+bool openHeapFile(const char* path, size_t size);
+
+/**
+ * @brief Сохранение и закрытие файла кучи, возврат к куче в памяти процесса.
+ */
+void closeHeapFile();
+
+/**
+ * @brief Проверка, отображена ли куча по адресу, отличному от адреса ее создания.
+ * @return true, если указатели, сохраненные внутри кучи, недействительны.
+ */
+bool isHeapRelocated();
+
+/**
+ * @brief Сохранение корневого объекта кучи, по которому данные находятся после перезапуска.
+ * @param ptr - указатель на блок памяти в куче.
+ */
+void setHeapRoot(void* ptr);
+
+/**
+ * @brief Выдать корневой объект кучи.
+ * @return указатель на корневой объект или NULL.
+ */
+void* getHeapRoot();
 }
@@ -3,60 +3,194 @@
 #include <algorithm>
 #include <iterator>
 #include <memory>
+#include <ratio>
+#include <stdexcept>
+#include <type_traits>
+
+#include "parallel.h"
 
 namespace custom {
+namespace detail {
+/**
+ * @brief Признак аллокатора, сообщающего реальный размер выделенного блока.
+ */
+template <typename A, typename = void>
+struct has_usable_size : std::false_type {};
+
+template <typename A>
+struct has_usable_size<A, decltype(void(std::declval<A&>().usable_size(
+    std::declval<typename A::pointer>(), std::declval<typename A::size_type>())))> : std::true_type {};
+
+/**
+ * @brief Признак аллокатора, выделяющего память без исключения (try_allocate).
+ */
+template <typename A, typename = void>
+struct has_try_allocate : std::false_type {};
+
+template <typename A>
+struct has_try_allocate<A, decltype(void(std::declval<A&>().try_allocate(
+    std::declval<typename A::size_type>())))> : std::true_type {};
+
+/**
+ * @brief Признак аллокатора, расширяющего блок на месте (try_expand).
+ */
+template <typename A, typename = void>
+struct has_try_expand : std::false_type {};
+
+template <typename A>
+struct has_try_expand<A, decltype(void(std::declval<A&>().try_expand(std::declval<typename A::pointer>(),
+    std::declval<typename A::size_type>(), std::declval<typename A::size_type>())))> : std::true_type {};
+
+/**
+ * @brief Получение обычного указателя из указателя аллокатора (в том числе offset_ptr).
+ */
+template <typename T>
+T* to_address(T* ptr) {
+  return ptr;
+}
+
+template <typename P>
+auto to_address(const P& ptr) -> decltype(ptr.operator->()) {
+  return ptr.operator->();
+}
+
+/**
+ * @brief Хранилище аллокатора контейнера.
+ *
+ * Аллокатор без состояния хранится внутри контейнера и не требует выделения памяти,
+ * поэтому контейнер, размещенный в файле кучи, не ссылается на память процесса.
+ * Аллокатор с состоянием (пул) хранится в отдельном объекте, чтобы блоки пула
+ * не перемещались при обмене контейнеров.
+ */
+template <typename A, bool = std::is_empty<A>::value>
+class allocator_holder : private A {
+  public:
+    A* operator->() {
+      return this;
+    }
+
+    const A* operator->() const {
+      return this;
+    }
+
+    const A& operator*() const {
+      return *this;
+    }
+
+    void swap(allocator_holder&) {}
+};
+
+template <typename A>
+class allocator_holder<A, false> {
+  public:
+    allocator_holder() : allocator_(std::make_unique<A>()) {}
+
+    A* operator->() const {
+      return allocator_.get();
+    }
+
+    const A& operator*() const {
+      return *allocator_;
+    }
+
+    void swap(allocator_holder& other) {
+      std::swap(allocator_, other.allocator_);
+    }
+
+  private:
+    std::unique_ptr<A> allocator_;
+};
+}
+
 /**
  * @brief Шаблон кастомного вектора.
+ * @tparam G - коэффициент роста емкости (std::ratio).
  */
-template <typename T, typename A = std::allocator<T>>
+template <typename T, typename A = std::allocator<T>, typename G = std::ratio<2>>
 class vector {
+    static_assert(G::num > G::den, "Growth factor must be greater than 1");
+
   public:
     using size_type = size_t;
     using value_type = T;
     using allocator_type = A;
-    using pointer = T*;
+    using growth_factor = G;
+    using difference_type = ptrdiff_t;
+    using pointer = typename std::allocator_traits<A>::pointer;
+    using const_pointer = typename std::allocator_traits<A>::const_pointer;
     using reference = T&;
     using const_reference = const T&;
 
     vector() : size_(0), capacity_(0), data_(nullptr) {
-      allocator_ = std::make_unique<allocator_type>();
     }
 
     explicit vector(size_type size) : size_(size), capacity_(size) {
-      allocator_ = std::make_unique<allocator_type>();
       data_ = allocator_->allocate(size_);
       for(size_type i = 0; i < size_; ++i)
         allocator_->construct(&data_[i]);
     }
 
     vector(size_type size, T value) : size_(size), capacity_(size) {
-      allocator_ = std::make_unique<allocator_type>();
       data_ = allocator_->allocate(size_);
       for(size_type i = 0; i < size_; ++i)
         allocator_->construct(&data_[i], value);
     }
 
+    /**
+     * @brief Создание size копий value несколькими потоками.
+     *
+     * Каждый поток создает элементы своей части и первым касается ее страниц памяти.
+     */
+    vector(size_type size, const T& value, const parallel_policy& policy) : size_(0), capacity_(size) {
+      data_ = allocator_->allocate(capacity_);
+      try {
+        constructParallel(size, policy, [this, &value](size_type i) {
+          allocator_->construct(&data_[i], value);
+        });
+      }
+      catch(...) {
+        allocator_->deallocate(data_, capacity_);
+        throw;
+      }
+      size_ = size;
+    }
+
     vector(const std::initializer_list<T>& vec) : size_(vec.size()), capacity_(vec.size()) {
-      allocator_ = std::make_unique<allocator_type>();
       data_ = allocator_->allocate(size_);
       for(size_type i = 0; i < vec.size(); ++i)
         allocator_->construct(&data_[i], *(vec.begin() + i));
     }
 
     vector(const vector& vec) : size_(vec.size_), capacity_(vec.capacity_) {
-      allocator_ = std::make_unique<allocator_type>();
       data_ = allocator_->allocate(capacity_);
       for(size_type i = 0; i < size_; ++i)
         allocator_->construct(&data_[i], vec.data_[i]);
     }
 
+    /**
+     * @brief Копирование вектора несколькими потоками.
+     */
+    vector(const vector& vec, const parallel_policy& policy) : size_(0), capacity_(vec.capacity_) {
+      data_ = allocator_->allocate(capacity_);
+      try {
+        constructParallel(vec.size_, policy, [this, &vec](size_type i) {
+          allocator_->construct(&data_[i], vec.data_[i]);
+        });
+      }
+      catch(...) {
+        allocator_->deallocate(data_, capacity_);
+        throw;
+      }
+      size_ = vec.size_;
+    }
+
     vector(vector&& vec) noexcept :
       size_(0), capacity_(0), data_(nullptr) {
       vec.swap(*this);
     }
 
     vector& operator = (vector const& vec) {
-      vector<T, A> tmp(vec);
+      vector<T, A, G> tmp(vec);
       tmp.swap(*this);
       return *this;
     }
@@ -111,7 +245,7 @@ class vector {
       std::swap(data_, other.data_);
       std::swap(size_, other.size_);
       std::swap(capacity_, other.capacity_);
-      std::swap(allocator_, other.allocator_);
+      allocator_.swap(other.allocator_);
     }
 
     T& front() {
@@ -143,125 +277,406 @@ class vector {
     }
 
     T& operator [] (size_type pos) {
-      if (pos > size_ - 1 || pos < 0)
+      return data_[pos];
+    }
+
+    const T& operator [] (size_type pos) const {
+      return data_[pos];
+    }
+
+    T& at(size_type pos) {
+      if (pos >= size_)
         throw std::out_of_range("Out of scope");
       else
         return data_[pos];
     }
 
-    const T& operator [] (size_type pos) const {
-      if (pos > size_ - 1 || pos < 0)
+    const T& at(size_type pos) const {
+      if (pos >= size_)
         throw std::out_of_range("Out of scope");
       else
         return data_[pos];
     }
 
+    T* data() {
+      return detail::to_address(data_);
+    }
+
+    const T* data() const {
+      return detail::to_address(data_);
+    }
+
     void resize(size_type size) {
       if(size < size_) {
         for(size_type i = size; i < size_; ++i)
           allocator_->destroy(&data_[i]);
         size_ = size;
       } else {
-        size_type i = size_;
         if (size > capacity_)
           reserveCapacity(size);
-        for(; i < size; ++i)
-          allocator_->construct(&data_[size_]);
+        for(size_type i = size_; i < size; ++i)
+          allocator_->construct(&data_[i]);
+        size_ = size;
+      }
+    }
+
+    /**
+     * @brief Изменение размера, новые элементы создаются (лишние удаляются) несколькими потоками.
+     */
+    void resize(size_type size, const parallel_policy& policy) {
+      if(size < size_) {
+        destroyParallel(size, size_ - size, policy);
+        size_ = size;
+      } else {
+        if (size > capacity_)
+          reserveCapacity(size);
+        size_type first = size_;
+        constructParallel(size - first, policy, [this, first](size_type i) {
+          allocator_->construct(&data_[first + i]);
+        });
+        size_ = size;
       }
     }
 
+    /**
+     * @brief Присвоение value всем элементам несколькими потоками.
+     */
+    void fill(const T& value, const parallel_policy& policy) {
+      parallel_for(policy, size_, [this, &value](size_type, size_type begin, size_type end) {
+        std::fill(data() + begin, data() + end, value);
+      });
+    }
+
     void reserve(size_type capacity) {
       if(capacity > capacity_) {
         reserveCapacity(capacity);
       }
     }
 
+    void shrink_to_fit() {
+      if(capacity_ == size_)
+        return;
+
+      if(size_ == 0) {
+        allocator_->deallocate(data_, capacity_);
+        data_ = nullptr;
+        capacity_ = 0;
+      }
+      else
+        reserveCapacity(size_);
+    }
+
+    size_type max_size() const {
+      return std::allocator_traits<allocator_type>::max_size(*allocator_);
+    }
+
     void clear() {
       for(size_type i = 0; i < size_; ++i)
         allocator_->destroy(&data_[i]);
       size_ = 0;
     }
 
-    struct iterator : std::iterator<std::bidirectional_iterator_tag, T> {
-        explicit iterator(pointer current) : current_(current) {}
+    /**
+     * @brief Удаление всех элементов несколькими потоками.
+     */
+    void clear(const parallel_policy& policy) {
+      destroyParallel(0, size_, policy);
+      size_ = 0;
+    }
+
+    /**
+     * @brief Замена содержимого копиями элементов [first, last), память выделяется один раз.
+     */
+    template <typename It>
+    void assign(It first, It last) {
+      clear();
+      reserve(static_cast<size_type>(std::distance(first, last)));
+      for(; first != last; ++first)
+        pushBackInternal(*first);
+    }
+
+    /**
+     * @brief Итератор произвольного доступа по непрерывному хранилищу.
+     */
+    template <typename U>
+    struct iterator_base {
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = typename std::remove_const<U>::type;
+        using difference_type = ptrdiff_t;
+        using pointer = U*;
+        using reference = U&;
+#if __cplusplus > 201703L
+        using iterator_concept = std::contiguous_iterator_tag;
+#endif
+
+        iterator_base() : current_(nullptr) {}
 
-        iterator& operator ++(){
+        explicit iterator_base(pointer current) : current_(current) {}
+
+        template <typename V, typename = typename std::enable_if<std::is_convertible<V*, U*>::value>::type>
+        iterator_base(const iterator_base<V>& other) : current_(other.operator->()) {}
+
+        iterator_base& operator ++(){
           current_++;
           return *this;
         }
 
-        iterator operator ++(int){
-          iterator temp = *this;
+        iterator_base operator ++(int){
+          iterator_base temp = *this;
           current_++;
           return temp;
         }
 
-        iterator& operator --(){
+        iterator_base& operator --(){
           current_--;
           return *this;
         }
 
-        iterator operator --(int){
-          iterator temp = *this;
+        iterator_base operator --(int){
+          iterator_base temp = *this;
           current_--;
           return temp;
         }
 
-        reference operator *() {
+        iterator_base& operator += (difference_type n) {
+          current_ += n;
+          return *this;
+        }
+
+        iterator_base& operator -= (difference_type n) {
+          current_ -= n;
+          return *this;
+        }
+
+        iterator_base operator + (difference_type n) const {
+          return iterator_base(current_ + n);
+        }
+
+        friend iterator_base operator + (difference_type n, const iterator_base& it) {
+          return it + n;
+        }
+
+        iterator_base operator - (difference_type n) const {
+          return iterator_base(current_ - n);
+        }
+
+        difference_type operator - (const iterator_base& other) const {
+          return current_ - other.current_;
+        }
+
+        reference operator *() const {
           return *current_;
         }
 
-        bool operator == (iterator &other) {
+        pointer operator ->() const {
+          return current_;
+        }
+
+        reference operator [](difference_type n) const {
+          return current_[n];
+        }
+
+        bool operator == (const iterator_base& other) const {
           return current_ == other.current_;
         }
 
-        bool operator != (iterator &other) {
+        bool operator != (const iterator_base& other) const {
           return !(*this == other);
         }
 
+        bool operator < (const iterator_base& other) const {
+          return current_ < other.current_;
+        }
+
+        bool operator > (const iterator_base& other) const {
+          return other < *this;
+        }
+
+        bool operator <= (const iterator_base& other) const {
+          return !(other < *this);
+        }
+
+        bool operator >= (const iterator_base& other) const {
+          return !(*this < other);
+        }
+
       private:
         pointer current_;
     };
 
+    using iterator = iterator_base<T>;
+    using const_iterator = iterator_base<const T>;
+
     iterator end() {
-      iterator it(data_ + size_);
+      iterator it(data() + size_);
       return it;
     }
 
     iterator begin() {
-      iterator it(data_);
+      iterator it(data());
+      return it;
+    }
+
+    const_iterator end() const {
+      const_iterator it(data() + size_);
+      return it;
+    }
+
+    const_iterator begin() const {
+      const_iterator it(data());
       return it;
     }
 
+    const_iterator cend() const {
+      return end();
+    }
+
+    const_iterator cbegin() const {
+      return begin();
+    }
+
   private:
     size_type size_{0};
     size_type capacity_{0};
     pointer data_;
-    std::unique_ptr<allocator_type> allocator_;
+    detail::allocator_holder<allocator_type> allocator_;
 
     void resizeIfRequire() {
       if (size_ == capacity_) {
-        size_type newCapacity = capacity_ < 2 ? 2 : capacity_ * 2;
-        reserveCapacity(newCapacity);
+        // Рост в G раз, но не менее чем на один элемент и не более max_size() аллокатора.
+        size_type maxCapacity = max_size();
+        if (capacity_ >= maxCapacity)
+          throw std::length_error("Vector is full");
+
+        size_type newCapacity = capacity_ < 2 ? 2 : capacity_ * G::num / G::den;
+        if (newCapacity <= capacity_)
+          newCapacity = capacity_ + 1;
+        if (newCapacity > maxCapacity)
+          newCapacity = maxCapacity;
+
+        // Если аллокатор не выдает полный шаг (пул фрагментирован старым и новым блоком),
+        // шаг уменьшается вдвое вплоть до одного элемента, сначала - расширением на месте.
+        for (size_type capacity = newCapacity; capacity > capacity_ + 1;
+             capacity = capacity_ + (capacity - capacity_) / 2) {
+          if (tryGrow(capacity, detail::has_try_allocate<allocator_type>()))
+            return;
+        }
+        if (!expandInPlace(capacity_ + 1, detail::has_try_expand<allocator_type>()))
+          reserveCapacity(capacity_ + 1);
       }
     }
 
+    /**
+     * @brief Попытка увеличить емкость до newCapacity без исключения при нехватке памяти.
+     * @return true, если емкость увеличена.
+     */
+    bool tryGrow(size_type newCapacity, std::true_type) {
+      if (expandInPlace(newCapacity, detail::has_try_expand<allocator_type>()))
+        return true;
+
+      auto data = allocator_->try_allocate(newCapacity);
+      if (data == nullptr)
+        return false;
+
+      relocate(data, newCapacity);
+      return true;
+    }
+
+    bool tryGrow(size_type newCapacity, std::false_type) {
+      reserveCapacity(newCapacity);
+      return true;
+    }
+
+    bool expandInPlace(size_type newCapacity, std::true_type) {
+      if ((data_ == nullptr) || !allocator_->try_expand(data_, capacity_, newCapacity))
+        return false;
+
+      capacity_ = newCapacity;
+      return true;
+    }
+
+    bool expandInPlace(size_type, std::false_type) {
+      return false;
+    }
+
+    size_type usableCapacity(pointer data, size_type n, std::true_type) const {
+      return allocator_->usable_size(data, n);
+    }
+
+    size_type usableCapacity(pointer, size_type n, std::false_type) const {
+      return n;
+    }
+
     void pushBackInternal(T const& value) {
-      allocator_->construct(data_ + size_, value);
+      allocator_->construct(data() + size_, value);
       ++size_;
     }
 
+    /**
+     * @brief Создание элементов [size_, size_ + count) частями в нескольких потоках.
+     *
+     * При исключении уже созданные элементы всех частей удаляются, и исключение передается дальше.
+     * @param construct - функция construct(i), создающая элемент с номером size_ + i.
+     */
+    template <typename F>
+    void constructParallel(size_type count, const parallel_policy& policy, F construct) {
+      size_type chunks = policy.workers(count);
+      std::unique_ptr<bool[]> done(new bool[chunks]());
+      size_type first = size_;
+      try {
+        parallel_for(policy, count, [this, &done, &construct, first](size_type chunk, size_type begin, size_type end) {
+          size_type i = begin;
+          try {
+            for(; i < end; ++i)
+              construct(i);
+          }
+          catch(...) {
+            for(size_type j = begin; j < i; ++j)
+              allocator_->destroy(&data_[first + j]);
+            throw;
+          }
+          done[chunk] = true;
+        });
+      }
+      catch(...) {
+        for(size_type chunk = 0; chunk < chunks; ++chunk) {
+          if(!done[chunk])
+            continue;
+          auto part = parallel_policy::range(chunk, chunks, count);
+          for(size_type j = part.first; j < part.second; ++j)
+            allocator_->destroy(&data_[first + j]);
+        }
+        throw;
+      }
+    }
+
+    /**
+     * @brief Удаление элементов [first, first + count) частями в нескольких потоках.
+     */
+    void destroyParallel(size_type first, size_type count, const parallel_policy& policy) {
+      parallel_for(policy, count, [this, first](size_type, size_type begin, size_type end) {
+        for(size_type i = begin; i < end; ++i)
+          allocator_->destroy(&data_[first + i]);
+      });
+    }
+
     void reserveCapacity(size_type newCapacity) {
-      auto data = allocator_->allocate(newCapacity);
+      relocate(allocator_->allocate(newCapacity), newCapacity);
+    }
 
+    /**
+     * @brief Перенос элементов в новый блок data емкостью newCapacity и освобождение старого.
+     */
+    void relocate(pointer data, size_type newCapacity) {
       for(size_type i = 0; i < size_; ++i) {
         allocator_->construct(&data[i], data_[i]);
         allocator_->destroy(&data_[i]);
       }
       allocator_->deallocate(data_, capacity_);
 
+      // Емкость округляется до реального размера блока, выданного аллокатором.
       data_ = data;
-      capacity_ = newCapacity;
+      capacity_ = usableCapacity(data, newCapacity, detail::has_usable_size<allocator_type>());
     }
 };
 
@@ -0,0 +1,526 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+#include "custom_vector.h"
+
+namespace custom {
+/**
+ * @brief Признак того, что вставляемый диапазон уже отсортирован и не содержит повторов.
+ */
+struct sorted_unique_t {
+  explicit sorted_unique_t() = default;
+};
+
+constexpr sorted_unique_t sorted_unique{};
+
+/**
+ * @brief Ассоциативный контейнер на отсортированных массивах.
+ *
+ * Ключи и значения хранятся в отдельных custom::vector, поэтому поиск проходит только
+ * по плотному массиву ключей, без узлов и переходов по указателям. Вставка и удаление
+ * сдвигают элементы, контейнер рассчитан на таблицы, которые чаще читаются, чем меняются.
+ * @tparam A - аллокатор пар ключ-значение, для массивов ключей и значений он перепривязывается.
+ */
+template <typename K, typename V, typename Compare = std::less<K>,
+          typename A = std::allocator<std::pair<const K, V>>>
+class flat_map {
+  public:
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = std::pair<K, V>;
+    using key_compare = Compare;
+    using allocator_type = A;
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+    using reference = std::pair<const K&, V&>;
+    using const_reference = std::pair<const K&, const V&>;
+    using key_container_type = vector<K, typename std::allocator_traits<A>::template rebind_alloc<K>>;
+    using mapped_container_type = vector<V, typename std::allocator_traits<A>::template rebind_alloc<V>>;
+    using index_container_type = vector<size_type, typename std::allocator_traits<A>::template rebind_alloc<size_type>>;
+
+    /**
+     * @brief Итератор по парам ключ-значение, разыменовывается в пару ссылок.
+     */
+    template <typename U>
+    struct iterator_base {
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = flat_map::value_type;
+        using difference_type = ptrdiff_t;
+        using reference = std::pair<const K&, U&>;
+
+        /**
+         * @brief Заместитель указателя для operator->.
+         */
+        struct pointer {
+            reference ref_;
+
+            const reference* operator ->() const {
+              return &ref_;
+            }
+        };
+
+        iterator_base() : key_(nullptr), value_(nullptr) {}
+
+        iterator_base(const K* key, U* value) : key_(key), value_(value) {}
+
+        template <typename W, typename = typename std::enable_if<std::is_convertible<W*, U*>::value>::type>
+        iterator_base(const iterator_base<W>& other) : key_(other.key()), value_(other.value()) {}
+
+        iterator_base& operator ++() {
+          ++key_;
+          ++value_;
+          return *this;
+        }
+
+        iterator_base operator ++(int) {
+          iterator_base temp = *this;
+          ++*this;
+          return temp;
+        }
+
+        iterator_base& operator --() {
+          --key_;
+          --value_;
+          return *this;
+        }
+
+        iterator_base operator --(int) {
+          iterator_base temp = *this;
+          --*this;
+          return temp;
+        }
+
+        iterator_base& operator += (difference_type n) {
+          key_ += n;
+          value_ += n;
+          return *this;
+        }
+
+        iterator_base& operator -= (difference_type n) {
+          return *this += -n;
+        }
+
+        iterator_base operator + (difference_type n) const {
+          return iterator_base(key_ + n, value_ + n);
+        }
+
+        friend iterator_base operator + (difference_type n, const iterator_base& it) {
+          return it + n;
+        }
+
+        iterator_base operator - (difference_type n) const {
+          return iterator_base(key_ - n, value_ - n);
+        }
+
+        difference_type operator - (const iterator_base& other) const {
+          return key_ - other.key_;
+        }
+
+        reference operator *() const {
+          return reference(*key_, *value_);
+        }
+
+        pointer operator ->() const {
+          return pointer{**this};
+        }
+
+        reference operator [](difference_type n) const {
+          return *(*this + n);
+        }
+
+        bool operator == (const iterator_base& other) const {
+          return key_ == other.key_;
+        }
+
+        bool operator != (const iterator_base& other) const {
+          return !(*this == other);
+        }
+
+        bool operator < (const iterator_base& other) const {
+          return key_ < other.key_;
+        }
+
+        bool operator > (const iterator_base& other) const {
+          return other < *this;
+        }
+
+        bool operator <= (const iterator_base& other) const {
+          return !(other < *this);
+        }
+
+        bool operator >= (const iterator_base& other) const {
+          return !(*this < other);
+        }
+
+        const K* key() const {
+          return key_;
+        }
+
+        U* value() const {
+          return value_;
+        }
+
+      private:
+        const K* key_;
+        U* value_;
+    };
+
+    using iterator = iterator_base<V>;
+    using const_iterator = iterator_base<const V>;
+
+    flat_map() {}
+
+    explicit flat_map(const Compare& comp) : comp_(comp) {}
+
+    template <typename InputIt>
+    flat_map(InputIt first, InputIt last) {
+      insert(first, last);
+    }
+
+    template <typename InputIt>
+    flat_map(sorted_unique_t, InputIt first, InputIt last) {
+      insert(sorted_unique, first, last);
+    }
+
+    flat_map(std::initializer_list<value_type> list) {
+      insert(list.begin(), list.end());
+    }
+
+    size_type size() const {
+      return keys_.size();
+    }
+
+    bool empty() const {
+      return keys_.size() == 0;
+    }
+
+    size_type capacity() const {
+      return keys_.capacity();
+    }
+
+    void reserve(size_type capacity) {
+      keys_.reserve(capacity);
+      values_.reserve(capacity);
+    }
+
+    void shrink_to_fit() {
+      keys_.shrink_to_fit();
+      values_.shrink_to_fit();
+    }
+
+    void clear() {
+      keys_.clear();
+      values_.clear();
+    }
+
+    void swap(flat_map& other) {
+      keys_.swap(other.keys_);
+      values_.swap(other.values_);
+      std::swap(comp_, other.comp_);
+    }
+
+    /**
+     * @brief Массив ключей в порядке сортировки.
+     */
+    const key_container_type& keys() const {
+      return keys_;
+    }
+
+    /**
+     * @brief Массив значений в порядке ключей.
+     */
+    const mapped_container_type& values() const {
+      return values_;
+    }
+
+    key_compare key_comp() const {
+      return comp_;
+    }
+
+    iterator begin() {
+      return iterator(keys_.data(), values_.data());
+    }
+
+    iterator end() {
+      return begin() + keys_.size();
+    }
+
+    const_iterator begin() const {
+      return const_iterator(keys_.data(), values_.data());
+    }
+
+    const_iterator end() const {
+      return begin() + keys_.size();
+    }
+
+    const_iterator cbegin() const {
+      return begin();
+    }
+
+    const_iterator cend() const {
+      return end();
+    }
+
+    iterator lower_bound(const K& key) {
+      return begin() + lowerBound(key);
+    }
+
+    const_iterator lower_bound(const K& key) const {
+      return begin() + lowerBound(key);
+    }
+
+    iterator find(const K& key) {
+      size_type pos = lowerBound(key);
+      return isKeyAt(pos, key) ? begin() + pos : end();
+    }
+
+    const_iterator find(const K& key) const {
+      size_type pos = lowerBound(key);
+      return isKeyAt(pos, key) ? begin() + pos : end();
+    }
+
+    bool contains(const K& key) const {
+      return isKeyAt(lowerBound(key), key);
+    }
+
+    size_type count(const K& key) const {
+      return contains(key) ? 1 : 0;
+    }
+
+    V& at(const K& key) {
+      size_type pos = lowerBound(key);
+      if(!isKeyAt(pos, key))
+        throw std::out_of_range("Key not found");
+      return values_[pos];
+    }
+
+    const V& at(const K& key) const {
+      size_type pos = lowerBound(key);
+      if(!isKeyAt(pos, key))
+        throw std::out_of_range("Key not found");
+      return values_[pos];
+    }
+
+    V& operator [] (const K& key) {
+      return insert(value_type(key, V())).first->second;
+    }
+
+    /**
+     * @brief Вставка пары, если ключа еще нет в контейнере.
+     * @return итератор на элемент с ключом и признак выполненной вставки.
+     */
+    std::pair<iterator, bool> insert(const value_type& value) {
+      size_type pos = lowerBound(value.first);
+      if(isKeyAt(pos, value.first))
+        return std::make_pair(begin() + pos, false);
+
+      // Если вставить значение не удалось, ключ удаляется, чтобы размеры массивов совпадали.
+      insertAt(keys_, pos, value.first);
+      try {
+        insertAt(values_, pos, value.second);
+      }
+      catch(...) {
+        eraseAt(keys_, pos);
+        throw;
+      }
+      return std::make_pair(begin() + pos, true);
+    }
+
+    /**
+     * @brief Вставка диапазона пар за один проход слияния.
+     *
+     * Новые элементы дописываются в конец, сортируются и сливаются с уже имеющимися,
+     * поэтому вставка m элементов стоит O((n + m) + m log m) вместо O(n * m).
+     * Из повторяющихся ключей остается первый, как у std::map::insert.
+     * Слияние берет у аллокатора контейнера временную память: новые массивы ключей
+     * и значений на n + m элементов и массив m индексов.
+     */
+    template <typename InputIt>
+    void insert(InputIt first, InputIt last) {
+      size_type oldSize = appendRange(first, last);
+      try {
+        mergeTail(oldSize, false);
+      }
+      catch(...) {
+        truncate(oldSize);
+        throw;
+      }
+    }
+
+    /**
+     * @brief Вставка уже отсортированного диапазона без повторов, без сортировки.
+     *
+     * Временная память та же, что у вставки неотсортированного диапазона.
+     */
+    template <typename InputIt>
+    void insert(sorted_unique_t, InputIt first, InputIt last) {
+      size_type oldSize = appendRange(first, last);
+      try {
+        mergeTail(oldSize, true);
+      }
+      catch(...) {
+        truncate(oldSize);
+        throw;
+      }
+    }
+
+    iterator erase(const_iterator pos) {
+      size_type index = static_cast<size_type>(pos - cbegin());
+      eraseAt(keys_, index);
+      eraseAt(values_, index);
+      return begin() + index;
+    }
+
+    size_type erase(const K& key) {
+      size_type pos = lowerBound(key);
+      if(!isKeyAt(pos, key))
+        return 0;
+
+      eraseAt(keys_, pos);
+      eraseAt(values_, pos);
+      return 1;
+    }
+
+    bool operator == (const flat_map& other) const {
+      return size() == other.size() &&
+             std::equal(keys_.begin(), keys_.end(), other.keys_.begin()) &&
+             std::equal(values_.begin(), values_.end(), other.values_.begin());
+    }
+
+    bool operator != (const flat_map& other) const {
+      return !operator == (other);
+    }
+
+  private:
+    key_container_type keys_;
+    mapped_container_type values_;
+    Compare comp_;
+
+    /**
+     * @brief Поиск первого ключа, не меньшего key, без ветвлений в цикле.
+     *
+     * Каждая итерация сдвигает начало окна условным присваиванием (cmov), длина окна
+     * уменьшается вдвое независимо от результата сравнения, поэтому нет промахов
+     * предсказателя переходов.
+     * @return индекс найденного ключа или size().
+     */
+    size_type lowerBound(const K& key) const {
+      size_type length = keys_.size();
+      if(length == 0)
+        return 0;
+
+      const K* base = keys_.data();
+      while(length > 1) {
+        size_type half = length / 2;
+        base = comp_(base[half], key) ? base + half : base;
+        length -= half;
+      }
+      return static_cast<size_type>(base - keys_.data()) + (comp_(*base, key) ? 1 : 0);
+    }
+
+    bool isKeyAt(size_type pos, const K& key) const {
+      return pos < keys_.size() && !comp_(key, keys_[pos]);
+    }
+
+    template <typename C, typename T>
+    static void insertAt(C& container, size_type pos, const T& value) {
+      container.push_back(value);
+      std::rotate(container.begin() + pos, container.end() - 1, container.end());
+    }
+
+    template <typename C>
+    static void eraseAt(C& container, size_type pos) {
+      std::rotate(container.begin() + pos, container.begin() + pos + 1, container.end());
+      container.pop_back();
+    }
+
+    /**
+     * @brief Дописывание диапазона в конец, при исключении дописанное удаляется.
+     * @return размер до дописывания.
+     */
+    template <typename InputIt>
+    size_type appendRange(InputIt first, InputIt last) {
+      size_type oldSize = keys_.size();
+      try {
+        for(; first != last; ++first) {
+          keys_.push_back(first->first);
+          values_.push_back(first->second);
+        }
+      }
+      catch(...) {
+        truncate(oldSize);
+        throw;
+      }
+      return oldSize;
+    }
+
+    /**
+     * @brief Удаление ключей и значений с позиции size до конца.
+     */
+    void truncate(size_type size) {
+      while(keys_.size() > size)
+        keys_.pop_back();
+      while(values_.size() > size)
+        values_.pop_back();
+    }
+
+    /**
+     * @brief Слияние дописанного хвоста [oldSize, size()) с отсортированной частью.
+     * @param oldSize - размер отсортированной части.
+     * @param sorted - хвост уже отсортирован и не содержит повторов.
+     */
+    void mergeTail(size_type oldSize, bool sorted) {
+      size_type newSize = keys_.size();
+      if(newSize == oldSize)
+        return;
+
+      // Порядок хвоста задается перестановкой индексов, чтобы не переставлять ключи и значения дважды.
+      index_container_type order(newSize - oldSize);
+      for(size_type i = 0; i < order.size(); ++i)
+        order[i] = oldSize + i;
+      if(!sorted)
+        std::stable_sort(order.begin(), order.end(), [this](size_type lhs, size_type rhs) {
+          return comp_(keys_[lhs], keys_[rhs]);
+        });
+
+      key_container_type keys;
+      mapped_container_type values;
+      keys.reserve(newSize);
+      values.reserve(newSize);
+
+      size_type i = 0;
+      auto tail = order.begin();
+      while(i < oldSize || tail != order.end()) {
+        size_type pos;
+        if(tail == order.end())
+          pos = i++;
+        else if(i == oldSize || comp_(keys_[*tail], keys_[i]))
+          pos = *tail++;
+        else if(comp_(keys_[i], keys_[*tail]))
+          pos = i++;
+        else {
+          // Ключ уже есть в контейнере: вставляемый элемент отбрасывается.
+          ++tail;
+          continue;
+        }
+
+        if(keys.size() > 0 && !comp_(keys.back(), keys_[pos]))
+          continue;
+
+        keys.push_back(keys_[pos]);
+        values.push_back(values_[pos]);
+      }
+
+      keys_.swap(keys);
+      values_.swap(values);
+    }
+};
+
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <new>
+
+namespace custom {
+/**
+ * @brief Пул кадров сопрограмм (и других короткоживущих объектов) по классам размера.
+ *
+ * Блоки классов 64, 128, ..., MAX_CLASS_SIZE байт берутся из кастомной кучи (при ее
+ * исчерпании - из глобальной) и после освобождения остаются в списке свободных
+ * блоков потока, поэтому повторное выделение кадра того же размера не обращается
+ * к куче. Блоки больше MAX_CLASS_SIZE выделяются и освобождаются напрямую.
+ * Перед каждым блоком хранится заголовок с признаком кучи, из которой он выделен.
+ * Список каждого класса хранит не более MAX_CACHED_BLOCKS блоков, остальные сразу
+ * возвращаются в кучу: поток, освобождающий кадры других потоков, не накапливает их.
+ */
+class frame_pool {
+  public:
+    ///< Размер наименьшего класса, байт.
+    static constexpr size_t MIN_CLASS_SIZE = 64;
+
+    ///< Размер наибольшего класса, байт.
+    static constexpr size_t MAX_CLASS_SIZE = 4096;
+
+    ///< Наибольшее количество свободных блоков одного класса в списке потока.
+    static constexpr size_t MAX_CACHED_BLOCKS = 64;
+
+    /**
+     * @brief Выделение блока.
+     * @param size - размер блока.
+     * @return указатель на блок (при нехватке памяти - исключение std::bad_alloc).
+     */
+    static void* allocate(size_t size);
+
+    /**
+     * @brief Освобождение блока.
+     * @param ptr - указатель на блок.
+     * @param size - размер, с которым блок был выделен.
+     */
+    static void deallocate(void* ptr, size_t size);
+
+    /**
+     * @brief Возврат в кучу свободных блоков, накопленных текущим потоком.
+     */
+    static void trim();
+};
+
+/**
+ * @brief Выделение кадров глобальным operator new (для сравнения с пулами).
+ */
+class global_frame_pool {
+  public:
+    static void* allocate(size_t size) {
+      return ::operator new(size);
+    }
+
+    static void deallocate(void* ptr, size_t) {
+      ::operator delete(ptr);
+    }
+};
+
+/**
+ * @brief Пул из N статических ячеек по SlotSize байт для кадров заранее известного размера.
+ *
+ * Ячейки выделяются и освобождаются за O(1) через список свободных ячеек. Блоки,
+ * не помещающиеся в ячейку, и запросы при занятых ячейках передаются в frame_pool.
+ */
+template <size_t SlotSize, size_t N>
+class fixed_frame_pool {
+  public:
+    static void* allocate(size_t size) {
+      if(size <= SLOT_SIZE) {
+        spin_lock lock;
+        if(freeSlot_ != nullptr) {
+          slot_t* slot = freeSlot_;
+          freeSlot_ = slot->next;
+          return slot;
+        }
+        if(unused_ < N)
+          return &slots_[unused_++];
+      }
+      return frame_pool::allocate(size);
+    }
+
+    static void deallocate(void* ptr, size_t size) {
+      if(owns(ptr)) {
+        spin_lock lock;
+        slot_t* slot = static_cast<slot_t*>(ptr);
+        slot->next = freeSlot_;
+        freeSlot_ = slot;
+      }
+      else
+        frame_pool::deallocate(ptr, size);
+    }
+
+    static bool owns(const void* ptr) {
+      auto bytePtr = static_cast<const uint8_t*>(ptr);
+      auto begin = reinterpret_cast<const uint8_t*>(slots_);
+      return (bytePtr >= begin) && (bytePtr < begin + sizeof(slots_));
+    }
+
+  private:
+    ///< Размер ячейки, кратный выравниванию кадра.
+    static constexpr size_t SLOT_SIZE = (SlotSize + alignof(max_align_t) - 1) / alignof(max_align_t) * alignof(max_align_t);
+
+    union slot_t {
+      slot_t* next;
+      alignas(max_align_t) uint8_t data[SLOT_SIZE];
+    };
+
+    /**
+     * @brief Захват списка ячеек на время операции (критическая секция - несколько инструкций).
+     */
+    struct spin_lock {
+      spin_lock() {
+        while(busy_.test_and_set(std::memory_order_acquire))
+          ;
+      }
+
+      ~spin_lock() {
+        busy_.clear(std::memory_order_release);
+      }
+    };
+
+    static slot_t slots_[N];
+    static slot_t* freeSlot_;
+    static size_t unused_;
+    static std::atomic_flag busy_;
+};
+
+template <size_t SlotSize, size_t N>
+typename fixed_frame_pool<SlotSize, N>::slot_t fixed_frame_pool<SlotSize, N>::slots_[N];
+
+template <size_t SlotSize, size_t N>
+typename fixed_frame_pool<SlotSize, N>::slot_t* fixed_frame_pool<SlotSize, N>::freeSlot_ = nullptr;
+
+template <size_t SlotSize, size_t N>
+size_t fixed_frame_pool<SlotSize, N>::unused_ = 0;
+
+template <size_t SlotSize, size_t N>
+std::atomic_flag fixed_frame_pool<SlotSize, N>::busy_ = ATOMIC_FLAG_INIT;
+
+/**
+ * @brief Примесь, направляющая operator new/delete класса в пул Pool.
+ *
+ * Тип обещания сопрограммы, унаследованный от pooled_frame, выделяет кадр
+ * сопрограммы из пула, так как компилятор ищет operator new в типе обещания.
+ */
+template <typename Pool = frame_pool>
+struct pooled_frame {
+  static void* operator new(size_t size) {
+    return Pool::allocate(size);
+  }
+
+  static void operator delete(void* ptr, size_t size) {
+    Pool::deallocate(ptr, size);
+  }
+};
+
+}
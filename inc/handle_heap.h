@@ -0,0 +1,185 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "custom_vector.h"
+
+namespace custom {
+/**
+ * @brief Куча с перемещаемыми блоками, доступными через дескрипторы.
+ *
+ * Блок адресуется дескриптором, а его адрес выдается только на время закрепления
+ * (pin/unpin). Незакрепленные блоки могут быть сдвинуты compact(), после чего вся
+ * свободная память между ними собирается в один непрерывный участок. Поэтому
+ * куча фиксированного размера не теряет пригодную емкость из-за фрагментации.
+ * Блоки перемещаются побайтовым копированием, в них можно хранить только объекты,
+ * допускающие такое перемещение (без указателей на самих себя).
+ */
+class handle_heap {
+  public:
+    /**
+     * @brief Дескриптор блока, 0 - недействительный дескриптор.
+     *
+     * Младшие INDEX_BITS бит - номер записи таблицы дескрипторов плюс один, старшие -
+     * поколение записи. Поколение меняется при каждом освобождении, поэтому дескриптор,
+     * сохраненный после release(), не указывает на блок, выделенный в той же записи позже.
+     */
+    using handle = uint32_t;
+
+    ///< Недействительный дескриптор.
+    static constexpr handle INVALID_HANDLE = 0;
+
+    ///< Количество бит номера записи в дескрипторе.
+    static constexpr unsigned INDEX_BITS = 20;
+
+    /**
+     * @brief Разметка кучи в переданной области памяти.
+     * @param memory - начало области, выровненное на 16 байт.
+     * @param size - размер области.
+     */
+    handle_heap(void* memory, size_t size);
+
+    handle_heap(const handle_heap&) = delete;
+
+    handle_heap& operator = (const handle_heap&) = delete;
+
+    /**
+     * @brief Выделение блока.
+     *
+     * Если подходящего свободного участка нет, а свободной памяти в сумме достаточно,
+     * куча уплотняется и поиск повторяется.
+     * @param size - размер выделяемого блока памяти.
+     * @return дескриптор блока или INVALID_HANDLE.
+     */
+    handle allocate(size_t size);
+
+    /**
+     * @brief Освобождение блока.
+     * @param h - дескриптор блока.
+     * @return true, если блок освобожден; false для недействительного дескриптора
+     * и для закрепленного блока (адрес которого используется).
+     */
+    bool release(handle h);
+
+    /**
+     * @brief Закрепление блока: пока блок закреплен, compact() его не перемещает.
+     * @param h - дескриптор блока.
+     * @return адрес блока или NULL для недействительного дескриптора.
+     */
+    void* pin(handle h);
+
+    /**
+     * @brief Снятие закрепления, адрес блока после этого может измениться.
+     * @param h - дескриптор блока.
+     */
+    void unpin(handle h);
+
+    /**
+     * @brief Выдать размер блока, доступный для использования.
+     * @param h - дескриптор блока.
+     */
+    size_t getUsableSize(handle h) const;
+
+    /**
+     * @brief Уплотнение кучи: незакрепленные блоки сдвигаются к началу области,
+     * свободная память объединяется (закрепленные блоки остаются на месте).
+     */
+    void compact();
+
+    /**
+     * @brief Выдать размер свободной памяти в куче, без учета фрагментации.
+     */
+    size_t getFreeSize() const;
+
+    /**
+     * @brief Выдать размер наибольшего непрерывного свободного участка.
+     */
+    size_t getLargestFreeBlock() const;
+
+  private:
+    struct block_t;
+
+    ///< Запись таблицы дескрипторов.
+    struct entry_t {
+      size_t offset;       // Смещение блока, у свободной записи - индекс следующей свободной записи.
+      uint32_t pins;       // Количество закреплений блока.
+      uint32_t generation; // Поколение записи, увеличивается при освобождении.
+      bool used;           // Запись занята.
+    };
+
+    ///< Начало области.
+    uint8_t* heap_;
+
+    ///< Размер области.
+    size_t size_;
+
+    ///< Размер свободной памяти (с заголовками свободных блоков).
+    size_t freeBytes_;
+
+    ///< Таблица дескрипторов.
+    vector<entry_t> entries_;
+
+    ///< Первая свободная запись таблицы.
+    size_t freeEntry_;
+
+    block_t* blockAt(size_t offset) const;
+
+    entry_t* entryOf(handle h);
+
+    const entry_t* entryOf(handle h) const;
+
+    /**
+     * @brief Поиск первого свободного участка нужного размера со слиянием соседних свободных блоков.
+     * @param size - полный размер блока с заголовком.
+     * @return смещение блока или size_, если участок не найден.
+     */
+    size_t findFree(size_t size);
+
+    /**
+     * @brief Разметка участка памяти как свободного блока.
+     */
+    void makeFree(size_t offset, size_t size);
+};
+
+/**
+ * @brief Закрепление блока handle_heap на время жизни объекта.
+ */
+template <typename T>
+class pinned {
+  public:
+    pinned(handle_heap& heap, handle_heap::handle h) :
+      heap_(heap), handle_(h), ptr_(static_cast<T*>(heap.pin(h))) {}
+
+    ~pinned() {
+      if(ptr_ != nullptr)
+        heap_.unpin(handle_);
+    }
+
+    pinned(const pinned&) = delete;
+
+    pinned& operator = (const pinned&) = delete;
+
+    T* get() const {
+      return ptr_;
+    }
+
+    T* operator ->() const {
+      return ptr_;
+    }
+
+    T& operator *() const {
+      return *ptr_;
+    }
+
+    T& operator [](size_t n) const {
+      return ptr_[n];
+    }
+
+  private:
+    handle_heap& heap_;
+    handle_heap::handle handle_;
+    T* ptr_;
+};
+
+}
@@ -0,0 +1,611 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "custom_vector.h"
+
+namespace custom {
+namespace detail {
+/**
+ * @brief Группа управляющих байтов хэш-таблицы, проверяемая одной SSE2-инструкцией.
+ *
+ * Управляющий байт занятой ячейки хранит младшие 7 бит хэша (H2), поэтому
+ * ключи сравниваются только в ячейках, где совпал H2.
+ */
+class ctrl_group {
+  public:
+    ///< Количество управляющих байтов в группе.
+    static constexpr size_t SIZE = 16;
+
+    ///< Свободная ячейка.
+    static constexpr int8_t EMPTY = -128;
+
+    ///< Ячейка удаленного элемента (не прерывает поиск).
+    static constexpr int8_t DELETED = -2;
+
+    explicit ctrl_group(const int8_t* ctrl) {
+#ifdef __SSE2__
+      ctrl_ = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+#else
+      std::memcpy(ctrl_, ctrl, SIZE);
+#endif
+    }
+
+    /**
+     * @brief Маска ячеек, управляющий байт которых равен h2.
+     */
+    uint32_t match(int8_t h2) const {
+#ifdef __SSE2__
+      return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl_, _mm_set1_epi8(h2))));
+#else
+      uint32_t mask = 0;
+      for(size_t i = 0; i < SIZE; ++i)
+        mask |= static_cast<uint32_t>(ctrl_[i] == h2) << i;
+      return mask;
+#endif
+    }
+
+    /**
+     * @brief Маска свободных ячеек.
+     */
+    uint32_t matchEmpty() const {
+      return match(EMPTY);
+    }
+
+    /**
+     * @brief Маска свободных и удаленных ячеек (у них установлен старший бит).
+     */
+    uint32_t matchEmptyOrDeleted() const {
+#ifdef __SSE2__
+      return static_cast<uint32_t>(_mm_movemask_epi8(ctrl_));
+#else
+      uint32_t mask = 0;
+      for(size_t i = 0; i < SIZE; ++i)
+        mask |= static_cast<uint32_t>(ctrl_[i] < 0) << i;
+      return mask;
+#endif
+    }
+
+    /**
+     * @brief Индекс младшего установленного бита маски.
+     */
+    static size_t lowestBit(uint32_t mask) {
+      return static_cast<size_t>(__builtin_ctz(mask));
+    }
+
+  private:
+#ifdef __SSE2__
+    __m128i ctrl_;
+#else
+    int8_t ctrl_[SIZE];
+#endif
+};
+}
+
+/**
+ * @brief Хэш-таблица с открытой адресацией.
+ *
+ * Ячейки и управляющие байты лежат в одном блоке, выделенном аллокатором A, поэтому
+ * вставка не выделяет узлов, а поиск проверяет сразу группу из 16 управляющих байтов.
+ * Таблица растет вдвое при заполнении на 7/8; емкость - степень двойки, не меньше 16.
+ * @tparam A - аллокатор пар ключ-значение, перепривязывается на тип ячейки.
+ */
+template <typename K, typename V, typename Hash = std::hash<K>,
+          typename A = std::allocator<std::pair<const K, V>>, typename KeyEqual = std::equal_to<K>>
+class hash_map {
+  public:
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = std::pair<const K, V>;
+    using hasher = Hash;
+    using key_equal = KeyEqual;
+    using allocator_type = A;
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+    using reference = value_type&;
+    using const_reference = const value_type&;
+
+  private:
+    /**
+     * @brief Ячейка таблицы: место под один элемент.
+     */
+    struct slot_t {
+        alignas(value_type) unsigned char data[sizeof(value_type)];
+
+        value_type* get() {
+          return reinterpret_cast<value_type*>(data);
+        }
+    };
+
+    using slot_allocator_type = typename std::allocator_traits<A>::template rebind_alloc<slot_t>;
+
+  public:
+    /**
+     * @brief Однонаправленный итератор по занятым ячейкам.
+     */
+    template <typename U>
+    struct iterator_base {
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = typename std::remove_const<U>::type;
+        using difference_type = ptrdiff_t;
+        using pointer = U*;
+        using reference = U&;
+
+        iterator_base() : ctrl_(nullptr), end_(nullptr), slot_(nullptr) {}
+
+        iterator_base(const int8_t* ctrl, const int8_t* end, slot_t* slot) : ctrl_(ctrl), end_(end), slot_(slot) {
+          skipFree();
+        }
+
+        template <typename W, typename = typename std::enable_if<std::is_convertible<W*, U*>::value>::type>
+        iterator_base(const iterator_base<W>& other) : ctrl_(other.ctrl_), end_(other.end_), slot_(other.slot_) {}
+
+        iterator_base& operator ++() {
+          ++ctrl_;
+          ++slot_;
+          skipFree();
+          return *this;
+        }
+
+        iterator_base operator ++(int) {
+          iterator_base temp = *this;
+          ++*this;
+          return temp;
+        }
+
+        reference operator *() const {
+          return *slot_->get();
+        }
+
+        pointer operator ->() const {
+          return slot_->get();
+        }
+
+        bool operator == (const iterator_base& other) const {
+          return ctrl_ == other.ctrl_;
+        }
+
+        bool operator != (const iterator_base& other) const {
+          return !(*this == other);
+        }
+
+      private:
+        template <typename W>
+        friend struct iterator_base;
+        friend class hash_map;
+
+        const int8_t* ctrl_;
+        const int8_t* end_;
+        slot_t* slot_;
+
+        void skipFree() {
+          while(ctrl_ != end_ && *ctrl_ < 0) {
+            ++ctrl_;
+            ++slot_;
+          }
+        }
+    };
+
+    using iterator = iterator_base<value_type>;
+    using const_iterator = iterator_base<const value_type>;
+
+    hash_map() {}
+
+    explicit hash_map(size_type capacity) {
+      reserve(capacity);
+    }
+
+    hash_map(std::initializer_list<value_type> list) {
+      reserve(list.size());
+      for(const auto& value: list)
+        insert(value);
+    }
+
+    hash_map(const hash_map& other) : hash_(other.hash_), equal_(other.equal_) {
+      reserve(other.size_);
+      for(const auto& value: other)
+        insertUnique(value);
+    }
+
+    hash_map(hash_map&& other) noexcept {
+      other.swap(*this);
+    }
+
+    hash_map& operator = (const hash_map& other) {
+      hash_map tmp(other);
+      tmp.swap(*this);
+      return *this;
+    }
+
+    hash_map& operator = (hash_map&& other) noexcept {
+      other.swap(*this);
+      return *this;
+    }
+
+    ~hash_map() {
+      destroyAll();
+      deallocateTable(slots_, capacity_);
+    }
+
+    void swap(hash_map& other) {
+      std::swap(slots_, other.slots_);
+      std::swap(ctrl_, other.ctrl_);
+      std::swap(capacity_, other.capacity_);
+      std::swap(size_, other.size_);
+      std::swap(growthLeft_, other.growthLeft_);
+      std::swap(hash_, other.hash_);
+      std::swap(equal_, other.equal_);
+      allocator_.swap(other.allocator_);
+    }
+
+    size_type size() const {
+      return size_;
+    }
+
+    bool empty() const {
+      return size_ == 0;
+    }
+
+    /**
+     * @brief Количество ячеек таблицы.
+     */
+    size_type capacity() const {
+      return capacity_;
+    }
+
+    float load_factor() const {
+      return capacity_ == 0 ? 0.0f : static_cast<float>(size_) / static_cast<float>(capacity_);
+    }
+
+    float max_load_factor() const {
+      return static_cast<float>(MAX_LOAD_NUM) / static_cast<float>(MAX_LOAD_DEN);
+    }
+
+    /**
+     * @brief Подготовка таблицы к хранению count элементов без перестроения.
+     */
+    void reserve(size_type count) {
+      if(count > size_ + growthLeft_)
+        rehash(count * MAX_LOAD_DEN / MAX_LOAD_NUM + 1);
+    }
+
+    /**
+     * @brief Перестроение таблицы с емкостью не меньше count (и достаточной для size()).
+     *
+     * Перестроение удаляет отметки удаленных элементов.
+     */
+    void rehash(size_type count) {
+      size_type minCapacity = size_ * MAX_LOAD_DEN / MAX_LOAD_NUM + 1;
+      if(count < minCapacity)
+        count = minCapacity;
+
+      size_type capacity = detail::ctrl_group::SIZE;
+      while(capacity < count)
+        capacity *= 2;
+
+      resizeTable(capacity);
+    }
+
+    void clear() {
+      destroyAll();
+      if(capacity_ > 0)
+        std::memset(ctrl_, detail::ctrl_group::EMPTY, capacity_);
+      size_ = 0;
+      growthLeft_ = maxLoad(capacity_);
+    }
+
+    iterator begin() {
+      return iterator(ctrl_, ctrl_ + capacity_, slots_);
+    }
+
+    iterator end() {
+      return iterator(ctrl_ + capacity_, ctrl_ + capacity_, slots_ + capacity_);
+    }
+
+    const_iterator begin() const {
+      return const_iterator(ctrl_, ctrl_ + capacity_, slots_);
+    }
+
+    const_iterator end() const {
+      return const_iterator(ctrl_ + capacity_, ctrl_ + capacity_, slots_ + capacity_);
+    }
+
+    const_iterator cbegin() const {
+      return begin();
+    }
+
+    const_iterator cend() const {
+      return end();
+    }
+
+    iterator find(const K& key) {
+      size_type pos = findIndex(key, hashOf(key));
+      return pos == capacity_ ? end() : iteratorAt(pos);
+    }
+
+    const_iterator find(const K& key) const {
+      size_type pos = findIndex(key, hashOf(key));
+      return pos == capacity_ ? end() : const_iterator(ctrl_ + pos, ctrl_ + capacity_, slots_ + pos);
+    }
+
+    bool contains(const K& key) const {
+      return findIndex(key, hashOf(key)) != capacity_;
+    }
+
+    size_type count(const K& key) const {
+      return contains(key) ? 1 : 0;
+    }
+
+    V& at(const K& key) {
+      size_type pos = findIndex(key, hashOf(key));
+      if(pos == capacity_)
+        throw std::out_of_range("Key not found");
+      return slots_[pos].get()->second;
+    }
+
+    const V& at(const K& key) const {
+      size_type pos = findIndex(key, hashOf(key));
+      if(pos == capacity_)
+        throw std::out_of_range("Key not found");
+      return slots_[pos].get()->second;
+    }
+
+    V& operator [] (const K& key) {
+      return try_emplace(key).first->second;
+    }
+
+    std::pair<iterator, bool> insert(const value_type& value) {
+      return try_emplace(value.first, value.second);
+    }
+
+    template <typename InputIt>
+    void insert(InputIt first, InputIt last) {
+      for(; first != last; ++first)
+        insert(*first);
+    }
+
+    /**
+     * @brief Вставка элемента, значение которого создается из args, если ключа еще нет.
+     * @return итератор на элемент с ключом и признак выполненной вставки.
+     */
+    template <typename ...Args>
+    std::pair<iterator, bool> try_emplace(const K& key, Args &&...args) {
+      size_t hash = hashOf(key);
+      size_type pos = findIndex(key, hash);
+      if(pos != capacity_)
+        return std::make_pair(iteratorAt(pos), false);
+
+      pos = prepareInsert(hash);
+      new(slots_[pos].get()) value_type(std::piecewise_construct, std::forward_as_tuple(key),
+                                        std::forward_as_tuple(std::forward<Args>(args)...));
+      setCtrl(pos, h2(hash));
+      ++size_;
+      return std::make_pair(iteratorAt(pos), true);
+    }
+
+    size_type erase(const K& key) {
+      size_type pos = findIndex(key, hashOf(key));
+      if(pos == capacity_)
+        return 0;
+
+      eraseAt(pos);
+      return 1;
+    }
+
+    iterator erase(const_iterator pos) {
+      size_type index = static_cast<size_type>(pos.ctrl_ - ctrl_);
+      eraseAt(index);
+      return iteratorAt(index + 1);
+    }
+
+  private:
+    ///< Максимальная доля занятых (и удаленных) ячеек.
+    static constexpr size_type MAX_LOAD_NUM = 7;
+    static constexpr size_type MAX_LOAD_DEN = 8;
+
+    slot_t* slots_{nullptr};
+    int8_t* ctrl_{nullptr};
+    size_type capacity_{0};
+    size_type size_{0};
+
+    ///< Количество свободных ячеек, которые можно занять до перестроения.
+    size_type growthLeft_{0};
+
+    Hash hash_;
+    KeyEqual equal_;
+    detail::allocator_holder<slot_allocator_type> allocator_;
+
+    static size_type maxLoad(size_type capacity) {
+      return capacity * MAX_LOAD_NUM / MAX_LOAD_DEN;
+    }
+
+    /**
+     * @brief Хэш ключа с перемешиванием бит (std::hash целых - тождественная функция).
+     */
+    size_t hashOf(const K& key) const {
+      uint64_t hash = static_cast<uint64_t>(hash_(key));
+      hash ^= hash >> 33;
+      hash *= 0xff51afd7ed558ccdULL;
+      hash ^= hash >> 33;
+      return static_cast<size_t>(hash);
+    }
+
+    static int8_t h2(size_t hash) {
+      return static_cast<int8_t>(hash & 0x7F);
+    }
+
+    /**
+     * @brief Номер первой группы последовательности проб.
+     */
+    size_type firstGroup(size_t hash) const {
+      return (hash >> 7) & (capacity_ / detail::ctrl_group::SIZE - 1);
+    }
+
+    iterator iteratorAt(size_type pos) {
+      return iterator(ctrl_ + pos, ctrl_ + capacity_, slots_ + pos);
+    }
+
+    void setCtrl(size_type pos, int8_t value) {
+      ctrl_[pos] = value;
+    }
+
+    /**
+     * @brief Поиск ячейки с ключом.
+     *
+     * Группы перебираются треугольной последовательностью, которая при числе групп -
+     * степени двойки обходит все группы. Поиск останавливается на группе со свободной ячейкой.
+     * @return индекс ячейки или capacity(), если ключа нет.
+     */
+    size_type findIndex(const K& key, size_t hash) const {
+      if(capacity_ == 0)
+        return capacity_;
+
+      size_type groupMask = capacity_ / detail::ctrl_group::SIZE - 1;
+      size_type group = firstGroup(hash);
+      for(size_type step = 1; ; ++step) {
+        size_type offset = group * detail::ctrl_group::SIZE;
+        detail::ctrl_group ctrl(ctrl_ + offset);
+        for(uint32_t mask = ctrl.match(h2(hash)); mask != 0; mask &= mask - 1) {
+          size_type pos = offset + detail::ctrl_group::lowestBit(mask);
+          if(equal_(slots_[pos].get()->first, key))
+            return pos;
+        }
+        if(ctrl.matchEmpty() != 0 || step > groupMask)
+          return capacity_;
+        group = (group + step) & groupMask;
+      }
+    }
+
+    /**
+     * @brief Поиск свободной или удаленной ячейки для нового элемента.
+     */
+    size_type findFree(size_t hash) const {
+      size_type groupMask = capacity_ / detail::ctrl_group::SIZE - 1;
+      size_type group = firstGroup(hash);
+      for(size_type step = 1; ; ++step) {
+        size_type offset = group * detail::ctrl_group::SIZE;
+        uint32_t mask = detail::ctrl_group(ctrl_ + offset).matchEmptyOrDeleted();
+        if(mask != 0)
+          return offset + detail::ctrl_group::lowestBit(mask);
+        group = (group + step) & groupMask;
+      }
+    }
+
+    /**
+     * @brief Выбор ячейки для нового элемента, при необходимости с перестроением таблицы.
+     */
+    size_type prepareInsert(size_t hash) {
+      if(capacity_ > 0) {
+        size_type pos = findFree(hash);
+        if(ctrl_[pos] == detail::ctrl_group::DELETED)
+          return pos;
+      }
+
+      if(growthLeft_ == 0) {
+        // Если ячейки заняты в основном удаленными элементами, таблица перестраивается без роста.
+        if(capacity_ > 0 && size_ < maxLoad(capacity_) / 2)
+          resizeTable(capacity_);
+        else
+          resizeTable(capacity_ == 0 ? detail::ctrl_group::SIZE : capacity_ * 2);
+      }
+
+      size_type pos = findFree(hash);
+      if(ctrl_[pos] == detail::ctrl_group::EMPTY)
+        --growthLeft_;
+      return pos;
+    }
+
+    /**
+     * @brief Удаление элемента. Ячейка становится свободной, если в ее группе уже есть
+     * свободная ячейка (через такую группу поиск не проходит), иначе - удаленной.
+     */
+    void eraseAt(size_type pos) {
+      slots_[pos].get()->~value_type();
+      --size_;
+
+      size_type offset = pos - pos % detail::ctrl_group::SIZE;
+      if(detail::ctrl_group(ctrl_ + offset).matchEmpty() != 0) {
+        setCtrl(pos, detail::ctrl_group::EMPTY);
+        ++growthLeft_;
+      }
+      else
+        setCtrl(pos, detail::ctrl_group::DELETED);
+    }
+
+    /**
+     * @brief Перенос элементов в новую таблицу из capacity ячеек.
+     */
+    void resizeTable(size_type capacity) {
+      slot_t* oldSlots = slots_;
+      int8_t* oldCtrl = ctrl_;
+      size_type oldCapacity = capacity_;
+
+      allocateTable(capacity);
+      for(size_type i = 0; i < oldCapacity; ++i) {
+        if(oldCtrl[i] < 0)
+          continue;
+
+        value_type* value = oldSlots[i].get();
+        size_t hash = hashOf(value->first);
+        size_type pos = findFree(hash);
+        new(slots_[pos].get()) value_type(std::move(*value));
+        value->~value_type();
+        setCtrl(pos, h2(hash));
+      }
+      growthLeft_ = maxLoad(capacity_) - size_;
+
+      deallocateTable(oldSlots, oldCapacity);
+    }
+
+    /**
+     * @brief Вставка элемента, которого заведомо нет в таблице.
+     */
+    void insertUnique(const value_type& value) {
+      size_t hash = hashOf(value.first);
+      size_type pos = prepareInsert(hash);
+      new(slots_[pos].get()) value_type(value);
+      setCtrl(pos, h2(hash));
+      ++size_;
+    }
+
+    /**
+     * @brief Количество ячеек, занимаемых блоком таблицы: ячейки и следом управляющие байты.
+     */
+    static size_type tableUnits(size_type capacity) {
+      return capacity + (capacity + sizeof(slot_t) - 1) / sizeof(slot_t);
+    }
+
+    void allocateTable(size_type capacity) {
+      auto table = allocator_->allocate(tableUnits(capacity));
+      slots_ = detail::to_address(table);
+      ctrl_ = reinterpret_cast<int8_t*>(slots_ + capacity);
+      std::memset(ctrl_, detail::ctrl_group::EMPTY, capacity);
+      capacity_ = capacity;
+    }
+
+    void deallocateTable(slot_t* slots, size_type capacity) {
+      if(slots != nullptr)
+        allocator_->deallocate(slots, tableUnits(capacity));
+    }
+
+    void destroyAll() {
+      for(size_type i = 0; i < capacity_; ++i)
+        if(ctrl_[i] >= 0)
+          slots_[i].get()->~value_type();
+    }
+};
+
+}
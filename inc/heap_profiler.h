@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <ostream>
+
+///< Точка входа, вызывающая recordAlloc: не встраивается, чтобы глубина стека семпла была постоянной.
+#define CUSTOM_PROFILED __attribute__((noinline))
+
+/**
+ * Функции профилировщика потокобезопасны. Стек семпла записывается без кадров
+ * recordAlloc и точки входа, вызвавшей его, поэтому точки входа куч и аллокаторов
+ * вызывают recordAlloc сами и не встраиваются (CUSTOM_PROFILED).
+ */
+namespace custom {
+namespace profiler {
+/**
+ * @brief Включение семплирующего профилировщика кучи.
+ * @param bytes - средний интервал между семплами в байтах (0 - профилировщик выключен).
+ */
+void setSampleRate(size_t bytes);
+
+/**
+ * @brief Выдать средний интервал между семплами.
+ * @return интервал в байтах (0 - профилировщик выключен).
+ */
+size_t getSampleRate();
+
+/**
+ * @brief Учет выделения блока, с вероятностью пропорциональной размеру сохраняется стек вызова.
+ *
+ * Не выбрасывает исключений: семпл, для которого не хватило памяти, отбрасывается.
+ * @param ptr - указатель на выделенный блок памяти.
+ * @param size - размер выделенного блока.
+ */
+void recordAlloc(void* ptr, size_t size) noexcept;
+
+/**
+ * @brief Учет освобождения блока.
+ * @param ptr - указатель на освобождаемый блок памяти.
+ */
+void recordFree(void* ptr) noexcept;
+
+/**
+ * @brief Вывод профиля в текстовом формате heap_v2, который читает pprof.
+ * @param os - поток для вывода.
+ */
+void dumpHeapProfile(std::ostream& os);
+
+/**
+ * @brief Вывод профиля в формате свернутых стеков (flamegraph.pl).
+ * @param os - поток для вывода.
+ * @param live - true для занятой в данный момент памяти, false для суммарно выделенной.
+ */
+void dumpFoldedStacks(std::ostream& os, bool live);
+
+/**
+ * @brief Очистка накопленных профилей.
+ */
+void reset();
+}
+}
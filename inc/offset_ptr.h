@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+
+namespace custom {
+/**
+ * @brief Указатель, хранящий смещение цели относительно собственного адреса.
+ *
+ * Остается верным, если указатель и цель лежат в одной области памяти, отображенной
+ * в разных процессах по разным адресам. Смещение 1 обозначает нулевой указатель.
+ */
+template <typename T>
+class offset_ptr {
+  public:
+    using element_type = T;
+    using value_type = typename std::remove_cv<T>::type;
+    using difference_type = ptrdiff_t;
+    using pointer = T*;
+    using reference = typename std::add_lvalue_reference<T>::type;
+    using iterator_category = std::random_access_iterator_tag;
+
+    template <typename U>
+    using rebind = offset_ptr<U>;
+
+    offset_ptr() : offset_(NULL_OFFSET) {}
+
+    offset_ptr(std::nullptr_t) : offset_(NULL_OFFSET) {}
+
+    offset_ptr(T* ptr) {
+      set(ptr);
+    }
+
+    offset_ptr(const offset_ptr& other) {
+      set(other.get());
+    }
+
+    template <typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+    offset_ptr(const offset_ptr<U>& other) {
+      set(other.get());
+    }
+
+    offset_ptr& operator = (const offset_ptr& other) {
+      set(other.get());
+      return *this;
+    }
+
+    offset_ptr& operator = (T* ptr) {
+      set(ptr);
+      return *this;
+    }
+
+    static offset_ptr pointer_to(reference ref) {
+      return offset_ptr(&ref);
+    }
+
+    T* get() const {
+      if(offset_ == NULL_OFFSET)
+        return nullptr;
+      return reinterpret_cast<T*>(reinterpret_cast<intptr_t>(this) + offset_);
+    }
+
+    T* operator ->() const {
+      return get();
+    }
+
+    reference operator *() const {
+      return *get();
+    }
+
+    reference operator [](difference_type n) const {
+      return get()[n];
+    }
+
+    explicit operator bool() const {
+      return offset_ != NULL_OFFSET;
+    }
+
+    offset_ptr& operator += (difference_type n) {
+      set(get() + n);
+      return *this;
+    }
+
+    offset_ptr& operator -= (difference_type n) {
+      set(get() - n);
+      return *this;
+    }
+
+    offset_ptr& operator ++() {
+      return *this += 1;
+    }
+
+    offset_ptr operator ++(int) {
+      offset_ptr temp = *this;
+      *this += 1;
+      return temp;
+    }
+
+    offset_ptr& operator --() {
+      return *this -= 1;
+    }
+
+    offset_ptr operator --(int) {
+      offset_ptr temp = *this;
+      *this -= 1;
+      return temp;
+    }
+
+    offset_ptr operator + (difference_type n) const {
+      return offset_ptr(get() + n);
+    }
+
+    offset_ptr operator - (difference_type n) const {
+      return offset_ptr(get() - n);
+    }
+
+    difference_type operator - (const offset_ptr& other) const {
+      return get() - other.get();
+    }
+
+    bool operator == (const offset_ptr& other) const {
+      return get() == other.get();
+    }
+
+    bool operator != (const offset_ptr& other) const {
+      return get() != other.get();
+    }
+
+    bool operator < (const offset_ptr& other) const {
+      return get() < other.get();
+    }
+
+  private:
+    ///< Смещение нулевого указателя (указатель не может указывать на свой второй байт).
+    static constexpr intptr_t NULL_OFFSET = 1;
+
+    ///< Смещение цели относительно this.
+    intptr_t offset_;
+
+    void set(T* ptr) {
+      if(ptr == nullptr)
+        offset_ = NULL_OFFSET;
+      else
+        offset_ = reinterpret_cast<intptr_t>(ptr) - reinterpret_cast<intptr_t>(this);
+    }
+};
+}
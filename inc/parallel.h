@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <exception>
+#include <memory>
+#include <thread>
+#include <utility>
+
+namespace custom {
+/**
+ * @brief Параметры параллельного выполнения массовых операций контейнеров.
+ *
+ * Диапазон делится на равные непрерывные части по числу потоков, поток с номером i
+ * всегда получает одну и ту же часть. Если обрабатывать данные потом с тем же
+ * разбиением (parallel_for), каждый поток работает со страницами памяти, которых
+ * он первым коснулся при создании элементов и которые ОС разместила на его узле NUMA.
+ */
+struct parallel_policy {
+  ///< Количество потоков (0 - по числу аппаратных потоков).
+  size_t threads;
+
+  ///< Минимальное количество элементов на поток, меньшие диапазоны обрабатываются меньшим числом потоков.
+  size_t grain;
+
+  explicit parallel_policy(size_t threads = 0, size_t grain = 65536) : threads(threads), grain(grain) {}
+
+  /**
+   * @brief Выдать количество частей (потоков) для диапазона из count элементов.
+   */
+  size_t workers(size_t count) const {
+    size_t workers = threads != 0 ? threads : std::thread::hardware_concurrency();
+    size_t byGrain = grain != 0 ? count / grain : count;
+    if(workers > byGrain)
+      workers = byGrain;
+    return workers > 0 ? workers : 1;
+  }
+
+  /**
+   * @brief Выдать границы части с номером chunk.
+   * @param chunk - номер части.
+   * @param chunks - количество частей.
+   * @param count - размер диапазона.
+   * @return начало и конец части.
+   */
+  static std::pair<size_t, size_t> range(size_t chunk, size_t chunks, size_t count) {
+    size_t base = count / chunks;
+    size_t rest = count % chunks;
+    size_t begin = chunk * base + (chunk < rest ? chunk : rest);
+    return std::make_pair(begin, begin + base + (chunk < rest ? 1 : 0));
+  }
+};
+
+/**
+ * @brief Параллельная обработка диапазона [0, count) частями.
+ *
+ * Часть 0 выполняется в вызывающем потоке, остальные - в отдельных потоках.
+ * Исключение из любой части передается вызывающему после завершения всех частей.
+ * @param policy - параметры разбиения.
+ * @param count - размер диапазона.
+ * @param fn - функция fn(chunk, begin, end), обрабатывающая одну часть.
+ */
+template <typename F>
+void parallel_for(const parallel_policy& policy, size_t count, F&& fn) {
+  size_t chunks = policy.workers(count);
+  if(chunks == 1) {
+    fn(size_t(0), size_t(0), count);
+    return;
+  }
+
+  std::unique_ptr<std::exception_ptr[]> errors(new std::exception_ptr[chunks]);
+  auto runChunk = [&](size_t chunk) {
+    try {
+      auto part = parallel_policy::range(chunk, chunks, count);
+      fn(chunk, part.first, part.second);
+    }
+    catch(...) {
+      errors[chunk] = std::current_exception();
+    }
+  };
+
+  std::unique_ptr<std::thread[]> threads(new std::thread[chunks - 1]);
+  size_t started = 0;
+  try {
+    for(; started < chunks - 1; ++started)
+      threads[started] = std::thread(runChunk, started + 1);
+  }
+  catch(...) {
+    // Части, для которых не удалось создать поток, выполняются в вызывающем потоке.
+    for(size_t chunk = started + 1; chunk < chunks; ++chunk)
+      runChunk(chunk);
+  }
+  runChunk(0);
+
+  for(size_t i = 0; i < started; ++i)
+    threads[i].join();
+
+  for(size_t chunk = 0; chunk < chunks; ++chunk)
+    if(errors[chunk])
+      std::rethrow_exception(errors[chunk]);
+}
+
+}
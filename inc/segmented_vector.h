@@ -0,0 +1,383 @@
+#pragma once
+
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+#include "custom_vector.h"
+
+namespace custom {
+/**
+ * @brief Вектор, хранящий элементы в сегментах фиксированного размера.
+ *
+ * При росте выделяется только новый сегмент, существующие элементы не копируются,
+ * поэтому пиковый расход памяти не превышает размер данных плюс один сегмент,
+ * а адреса элементов не меняются. Индекс элемента делится на номер сегмента
+ * и смещение в нем сдвигом и маской.
+ * @tparam SegSize - количество элементов в сегменте, степень двойки.
+ */
+template <typename T, size_t SegSize = 1024, typename A = std::allocator<T>>
+class segmented_vector {
+    static_assert(SegSize > 0 && (SegSize & (SegSize - 1)) == 0, "Segment size must be a power of two");
+
+  public:
+    using size_type = size_t;
+    using value_type = T;
+    using allocator_type = A;
+    using difference_type = ptrdiff_t;
+    using reference = T&;
+    using const_reference = const T&;
+
+    ///< Количество элементов в сегменте.
+    static constexpr size_type SEGMENT_SIZE = SegSize;
+
+    /**
+     * @brief Итератор произвольного доступа по индексу элемента.
+     */
+    template <typename U>
+    struct iterator_base {
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = typename std::remove_const<U>::type;
+        using difference_type = ptrdiff_t;
+        using pointer = U*;
+        using reference = U&;
+        using owner_type = typename std::conditional<std::is_const<U>::value,
+                                                     const segmented_vector, segmented_vector>::type;
+
+        iterator_base() : owner_(nullptr), index_(0) {}
+
+        iterator_base(owner_type* owner, size_type index) : owner_(owner), index_(index) {}
+
+        template <typename V, typename = typename std::enable_if<std::is_convertible<V*, U*>::value>::type>
+        iterator_base(const iterator_base<V>& other) : owner_(other.owner()), index_(other.index()) {}
+
+        iterator_base& operator ++() {
+          ++index_;
+          return *this;
+        }
+
+        iterator_base operator ++(int) {
+          iterator_base temp = *this;
+          ++index_;
+          return temp;
+        }
+
+        iterator_base& operator --() {
+          --index_;
+          return *this;
+        }
+
+        iterator_base operator --(int) {
+          iterator_base temp = *this;
+          --index_;
+          return temp;
+        }
+
+        iterator_base& operator += (difference_type n) {
+          index_ += n;
+          return *this;
+        }
+
+        iterator_base& operator -= (difference_type n) {
+          index_ -= n;
+          return *this;
+        }
+
+        iterator_base operator + (difference_type n) const {
+          return iterator_base(owner_, index_ + n);
+        }
+
+        friend iterator_base operator + (difference_type n, const iterator_base& it) {
+          return it + n;
+        }
+
+        iterator_base operator - (difference_type n) const {
+          return iterator_base(owner_, index_ - n);
+        }
+
+        difference_type operator - (const iterator_base& other) const {
+          return static_cast<difference_type>(index_) - static_cast<difference_type>(other.index_);
+        }
+
+        reference operator *() const {
+          return (*owner_)[index_];
+        }
+
+        pointer operator ->() const {
+          return &(*owner_)[index_];
+        }
+
+        reference operator [](difference_type n) const {
+          return (*owner_)[index_ + n];
+        }
+
+        bool operator == (const iterator_base& other) const {
+          return index_ == other.index_;
+        }
+
+        bool operator != (const iterator_base& other) const {
+          return !(*this == other);
+        }
+
+        bool operator < (const iterator_base& other) const {
+          return index_ < other.index_;
+        }
+
+        bool operator > (const iterator_base& other) const {
+          return other < *this;
+        }
+
+        bool operator <= (const iterator_base& other) const {
+          return !(other < *this);
+        }
+
+        bool operator >= (const iterator_base& other) const {
+          return !(*this < other);
+        }
+
+        owner_type* owner() const {
+          return owner_;
+        }
+
+        size_type index() const {
+          return index_;
+        }
+
+      private:
+        owner_type* owner_;
+        size_type index_;
+    };
+
+    using iterator = iterator_base<T>;
+    using const_iterator = iterator_base<const T>;
+
+    segmented_vector() : size_(0) {}
+
+    segmented_vector(size_type size, const T& value) : size_(0) {
+      reserve(size);
+      for(size_type i = 0; i < size; ++i)
+        push_back(value);
+    }
+
+    segmented_vector(const std::initializer_list<T>& list) : size_(0) {
+      reserve(list.size());
+      for(const auto& value: list)
+        push_back(value);
+    }
+
+    segmented_vector(const segmented_vector& other) : size_(0) {
+      reserve(other.size_);
+      for(const auto& value: other)
+        push_back(value);
+    }
+
+    segmented_vector(segmented_vector&& other) noexcept : size_(0) {
+      other.swap(*this);
+    }
+
+    segmented_vector& operator = (const segmented_vector& other) {
+      segmented_vector tmp(other);
+      tmp.swap(*this);
+      return *this;
+    }
+
+    segmented_vector& operator = (segmented_vector&& other) noexcept {
+      other.swap(*this);
+      return *this;
+    }
+
+    ~segmented_vector() {
+      clear();
+      releaseSegments(0);
+    }
+
+    void swap(segmented_vector& other) {
+      segments_.swap(other.segments_);
+      std::swap(size_, other.size_);
+      allocator_.swap(other.allocator_);
+    }
+
+    size_type size() const {
+      return size_;
+    }
+
+    bool empty() const {
+      return size_ == 0;
+    }
+
+    size_type capacity() const {
+      return segments_.size() * SegSize;
+    }
+
+    void push_back(const T& value) {
+      if(size_ == capacity())
+        addSegment();
+      allocator_->construct(&(*this)[size_], value);
+      ++size_;
+    }
+
+    void pop_back() {
+      if(size_ > 0) {
+        size_--;
+        allocator_->destroy(&(*this)[size_]);
+      }
+    }
+
+    void resize(size_type size) {
+      if(size < size_) {
+        while(size_ > size)
+          pop_back();
+      } else {
+        reserve(size);
+        for(; size_ < size; ++size_)
+          allocator_->construct(&(*this)[size_]);
+      }
+    }
+
+    /**
+     * @brief Выделение сегментов под capacity элементов.
+     */
+    void reserve(size_type capacity) {
+      while(this->capacity() < capacity)
+        addSegment();
+    }
+
+    /**
+     * @brief Освобождение сегментов, в которых нет элементов.
+     */
+    void shrink_to_fit() {
+      releaseSegments((size_ + SegSize - 1) / SegSize);
+    }
+
+    /**
+     * @brief Удаление всех элементов, сегменты остаются выделенными.
+     */
+    void clear() {
+      for(size_type i = 0; i < size_; ++i)
+        allocator_->destroy(&(*this)[i]);
+      size_ = 0;
+    }
+
+    T& operator [] (size_type pos) {
+      return segments_[pos / SegSize][pos & (SegSize - 1)];
+    }
+
+    const T& operator [] (size_type pos) const {
+      return segments_[pos / SegSize][pos & (SegSize - 1)];
+    }
+
+    T& at(size_type pos) {
+      if (pos >= size_)
+        throw std::out_of_range("Out of scope");
+      else
+        return (*this)[pos];
+    }
+
+    const T& at(size_type pos) const {
+      if (pos >= size_)
+        throw std::out_of_range("Out of scope");
+      else
+        return (*this)[pos];
+    }
+
+    T& front() {
+      if (size_ > 0)
+        return (*this)[0];
+      else
+        throw std::out_of_range("Empty vector");
+    }
+
+    const T& front() const {
+      if (size_ > 0)
+        return (*this)[0];
+      else
+        throw std::out_of_range("Empty vector");
+    }
+
+    T& back() {
+      if (size_ > 0)
+        return (*this)[size_ - 1];
+      else
+        throw std::out_of_range("Empty vector");
+    }
+
+    const T& back() const {
+      if (size_ > 0)
+        return (*this)[size_ - 1];
+      else
+        throw std::out_of_range("Empty vector");
+    }
+
+    /**
+     * @brief Количество сегментов.
+     */
+    size_type segment_count() const {
+      return segments_.size();
+    }
+
+    /**
+     * @brief Начало сегмента, элементы внутри сегмента лежат непрерывно.
+     */
+    T* segment(size_type index) {
+      return segments_[index];
+    }
+
+    const T* segment(size_type index) const {
+      return segments_[index];
+    }
+
+    iterator begin() {
+      return iterator(this, 0);
+    }
+
+    iterator end() {
+      return iterator(this, size_);
+    }
+
+    const_iterator begin() const {
+      return const_iterator(this, 0);
+    }
+
+    const_iterator end() const {
+      return const_iterator(this, size_);
+    }
+
+    const_iterator cbegin() const {
+      return begin();
+    }
+
+    const_iterator cend() const {
+      return end();
+    }
+
+  private:
+    ///< Таблица сегментов, при росте копируются только указатели.
+    vector<T*, typename std::allocator_traits<A>::template rebind_alloc<T*>> segments_;
+    size_type size_;
+    detail::allocator_holder<allocator_type> allocator_;
+
+    void addSegment() {
+      T* segment = detail::to_address(allocator_->allocate(SegSize));
+      try {
+        segments_.push_back(segment);
+      }
+      catch(...) {
+        allocator_->deallocate(segment, SegSize);
+        throw;
+      }
+    }
+
+    /**
+     * @brief Освобождение сегментов начиная с first.
+     */
+    void releaseSegments(size_type first) {
+      while(segments_.size() > first) {
+        allocator_->deallocate(segments_.back(), SegSize);
+        segments_.pop_back();
+      }
+    }
+};
+
+}
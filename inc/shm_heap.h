@@ -0,0 +1,199 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <new>
+#include <utility>
+
+#include "offset_ptr.h"
+
+namespace custom {
+/**
+ * @brief Куча в разделяемой памяти POSIX для обмена данными между процессами без копирования.
+ *
+ * Служебные структуры кучи и блоки лежат в сегменте shm_open, доступ к ним
+ * сериализуется мьютексом, разделяемым между процессами. Контейнеры в сегменте
+ * используют shm_allocator, указатели которого хранят смещения, поэтому сегмент
+ * может быть отображен в каждом процессе по своему адресу.
+ */
+class shm_heap {
+  public:
+    shm_heap();
+
+    ~shm_heap();
+
+    shm_heap(const shm_heap&) = delete;
+
+    shm_heap& operator = (const shm_heap&) = delete;
+
+    ///< Время ожидания инициализации сегмента его создателем по умолчанию, мс.
+    static constexpr unsigned DEFAULT_OPEN_TIMEOUT = 2000;
+
+    /**
+     * @brief Создание сегмента либо подключение к существующему.
+     *
+     * Подключение ожидает, пока создатель разметит сегмент. Если создатель завершился,
+     * не закончив разметку, ожидание прерывается по истечении timeout.
+     * @param name - имя сегмента ("/name").
+     * @param size - размер кучи при создании сегмента.
+     * @param timeout - время ожидания разметки сегмента, мс.
+     * @return true, если сегмент отображен в память.
+     */
+    bool open(const char* name, size_t size, unsigned timeout = DEFAULT_OPEN_TIMEOUT);
+
+    /**
+     * @brief Отключение от сегмента, сам сегмент продолжает существовать.
+     */
+    void close();
+
+    /**
+     * @brief Удаление сегмента из системы (после отключения всех процессов).
+     * @param name - имя сегмента.
+     * @return true, если сегмент удален.
+     */
+    static bool remove(const char* name);
+
+    /**
+     * @brief Выделение памяти в сегменте.
+     * @param size - размер выделяемого блока памяти.
+     * @return указатель на выделенный блок памяти или NULL.
+     */
+    void* malloc(size_t size);
+
+    /**
+     * @brief Освобождение памяти в сегменте.
+     * @param ptr - указатель на удаляемый блок памяти (указатель вне сегмента игнорируется).
+     */
+    void free(void* ptr);
+
+    /**
+     * @brief Выдать размер свободной памяти в сегменте, без учета фрагментации.
+     */
+    size_t getFreeSize();
+
+    /**
+     * @brief Сохранение корневого объекта сегмента, по которому его находят другие процессы.
+     * @param ptr - указатель на блок памяти в сегменте.
+     */
+    void setRoot(void* ptr);
+
+    /**
+     * @brief Выдать корневой объект сегмента.
+     * @return указатель на корневой объект в адресах текущего процесса или NULL.
+     */
+    void* getRoot();
+
+    /**
+     * @brief Проверка принадлежности указателя сегменту.
+     */
+    bool contains(const void* ptr) const;
+
+    /**
+     * @brief Назначение кучи, из которой выделяет память shm_allocator в этом процессе.
+     */
+    void use();
+
+    /**
+     * @brief Выдать кучу, из которой выделяет память shm_allocator.
+     *
+     * Чтение и назначение текущей кучи согласованы с open() и close(), но выданная
+     * куча должна оставаться открытой, пока вызывающий с ней работает.
+     */
+    static shm_heap* current();
+
+    /**
+     * @brief Поиск открытой в процессе кучи, отображению сегмента которой принадлежит указатель.
+     * @param ptr - указатель на блок памяти.
+     * @return куча или NULL, если указатель не принадлежит ни одному сегменту.
+     */
+    static shm_heap* owner(const void* ptr);
+
+  private:
+    struct control_t;
+
+    ///< Управляющий блок в начале сегмента.
+    control_t* control_;
+
+    ///< Размер отображения.
+    size_t mappedSize_;
+
+    ///< Следующая открытая куча процесса.
+    shm_heap* next_;
+
+    void lock();
+
+    void unlock();
+};
+
+/**
+ * @brief Аллокатор для контейнеров в разделяемой памяти.
+ *
+ * Блок освобождается в сегмент, которому он принадлежит. Выделяется память в сегменте,
+ * где лежит сам аллокатор (вместе с контейнером), а аллокатором вне сегментов -
+ * в текущей shm_heap.
+ */
+template <typename T>
+class shm_allocator
+{
+  public:
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+    using pointer = offset_ptr<T>;
+    using const_pointer = offset_ptr<const T>;
+    using reference = T&;
+    using const_reference = const T&;
+    using value_type = T;
+
+    shm_allocator() {}
+
+    ~shm_allocator() {}
+
+    template <class U>
+    shm_allocator(const shm_allocator<U>&) {}
+
+    pointer allocate(size_type n, const void* = 0) {
+      shm_heap* heap = shm_heap::owner(this);
+      if(heap == nullptr)
+        heap = shm_heap::current();
+      T* ptr = heap ? static_cast<T*>(heap->malloc(n * sizeof(T))) : nullptr;
+      if(ptr == nullptr)
+        throw std::bad_alloc();
+      return pointer(ptr);
+    }
+
+    void deallocate(pointer ptr, size_type) {
+      shm_heap* heap = shm_heap::owner(ptr.get());
+      if (heap) {
+        heap->free(ptr.get());
+      }
+    }
+
+    bool operator != (const shm_allocator&) const {
+      return false;
+    }
+
+    bool operator == (const shm_allocator&) const {
+      return true;
+    }
+
+    template<typename U, typename ...Args>
+    void construct(U* ptr, Args &&...args) {
+      new(ptr) U(std::forward<Args>(args)...);
+    }
+
+    template<typename U>
+    void destroy(U* ptr) {
+      ptr->~U();
+    }
+
+    size_type max_size() const {
+      return size_t(-1) / sizeof(T);
+    }
+
+    template <class U>
+    struct rebind {
+        using other = shm_allocator<U>;
+    };
+};
+
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "frame_pool.h"
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+namespace custom {
+namespace detail {
+/**
+ * @brief Общая часть обещания задачи: кадр берется из Pool, по завершении управление
+ * передается ожидающей сопрограмме.
+ *
+ * Передача управления идет через флаг, а не возвратом дескриптора из await_suspend:
+ * без оптимизации хвостовых вызовов (отладочная сборка) возврат дескриптора растит
+ * стек на каждый co_await. Флаг выставляют и задача при завершении, и ожидающий после
+ * запуска задачи; второй из них продолжает ожидающую сопрограмму.
+ */
+template <typename Pool>
+struct task_promise_base : pooled_frame<Pool> {
+  ///< Сопрограмма, ожидающая завершения задачи.
+  std::coroutine_handle<> continuation;
+
+  ///< Флаг встречи задачи и ожидающего.
+  std::atomic<bool> ready{false};
+
+  ///< Исключение, выброшенное задачей.
+  std::exception_ptr error;
+
+  struct final_awaiter {
+    bool await_ready() const noexcept {
+      return false;
+    }
+
+    template <typename P>
+    void await_suspend(std::coroutine_handle<P> handle) noexcept {
+      auto& promise = handle.promise();
+      if(promise.ready.exchange(true, std::memory_order_acq_rel))
+        promise.continuation.resume();
+    }
+
+    void await_resume() const noexcept {}
+  };
+
+  std::suspend_always initial_suspend() const noexcept {
+    return {};
+  }
+
+  final_awaiter final_suspend() const noexcept {
+    return {};
+  }
+
+  void unhandled_exception() noexcept {
+    error = std::current_exception();
+  }
+
+  void rethrowIfFailed() const {
+    if(error)
+      std::rethrow_exception(error);
+  }
+};
+
+template <typename T, typename Pool>
+struct task_promise : task_promise_base<Pool> {
+  T value{};
+
+  void return_value(T result) {
+    value = std::move(result);
+  }
+
+  T result() {
+    this->rethrowIfFailed();
+    return std::move(value);
+  }
+};
+
+template <typename Pool>
+struct task_promise<void, Pool> : task_promise_base<Pool> {
+  void return_void() const noexcept {}
+
+  void result() const {
+    this->rethrowIfFailed();
+  }
+};
+}
+
+/**
+ * @brief Ленивая задача-сопрограмма, кадр которой выделяется из пула Pool.
+ *
+ * Задача запускается при co_await или вызовом get() в обычном коде.
+ */
+template <typename T = void, typename Pool = frame_pool>
+class task {
+  public:
+    struct promise_type : detail::task_promise<T, Pool> {
+      task get_return_object() {
+        return task(std::coroutine_handle<promise_type>::from_promise(*this));
+      }
+    };
+
+    task(task&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+
+    task& operator = (task&& other) noexcept {
+      std::swap(handle_, other.handle_);
+      return *this;
+    }
+
+    task(const task&) = delete;
+
+    task& operator = (const task&) = delete;
+
+    ~task() {
+      if(handle_)
+        handle_.destroy();
+    }
+
+    bool await_ready() const noexcept {
+      return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> awaiting) noexcept {
+      handle_.promise().continuation = awaiting;
+      handle_.resume();
+      // Задача, завершившаяся синхронно, уже выставила флаг: ожидающий продолжает сам.
+      return !handle_.promise().ready.exchange(true, std::memory_order_acq_rel);
+    }
+
+    T await_resume() {
+      return handle_.promise().result();
+    }
+
+    /**
+     * @brief Выполнение задачи в текущем потоке и получение результата.
+     *
+     * Подходит для задач, которые ожидают только другие такие же задачи
+     * и поэтому завершаются за одно возобновление.
+     */
+    T get() {
+      if(!handle_.done())
+        handle_.resume();
+      return handle_.promise().result();
+    }
+
+  private:
+    explicit task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+}
+
+#endif
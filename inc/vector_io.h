@@ -0,0 +1,201 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <stdexcept>
+#include <type_traits>
+
+#include "custom_vector.h"
+
+namespace custom {
+namespace detail {
+/**
+ * @brief Запись файла вектора: заголовок и данные элементов одним вызовом writev.
+ *
+ * Файл записывается рядом под именем path.tmp и после fsync атомарно заменяет path:
+ * открытые отображения старого файла остаются верными, а сбой не оставляет недописанный файл.
+ * @param path - путь к файлу.
+ * @param elementSize - размер элемента.
+ * @param elementAlign - выравнивание элемента.
+ * @param data - элементы.
+ * @param count - количество элементов.
+ * @return true, если файл записан целиком.
+ */
+bool writeVectorFile(const char* path, size_t elementSize, size_t elementAlign, const void* data, size_t count);
+
+/**
+ * @brief Отображение файла вектора в память только для чтения.
+ * @param path - путь к файлу.
+ * @param elementSize - ожидаемый размер элемента.
+ * @param elementAlign - ожидаемое выравнивание элемента.
+ * @param count - количество элементов в файле.
+ * @param mappedSize - размер отображения.
+ * @return начало отображения или NULL, если файл не открыт или не соответствует типу.
+ */
+const uint8_t* mapVectorFile(const char* path, size_t elementSize, size_t elementAlign,
+                             size_t& count, size_t& mappedSize);
+
+/**
+ * @brief Выдать смещение данных элементов от начала файла вектора.
+ */
+size_t vectorFilePayloadOffset();
+
+/**
+ * @brief Снятие отображения файла вектора.
+ */
+void unmapVectorFile(const uint8_t* base, size_t mappedSize);
+}
+
+/**
+ * @brief Сохранение вектора в файл: версионированный заголовок и непрерывные данные элементов.
+ * @param path - путь к файлу.
+ * @param vec - сохраняемый вектор.
+ * @return true, если файл записан.
+ */
+template <typename T, typename A, typename G>
+bool saveVector(const char* path, const vector<T, A, G>& vec) {
+  static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable elements can be saved as raw bytes");
+  return detail::writeVectorFile(path, sizeof(T), alignof(T), vec.data(), vec.size());
+}
+
+/**
+ * @brief Вектор только для чтения, данные которого отображены из файла saveVector.
+ *
+ * Элементы не копируются и не разбираются: страницы файла подгружаются ОС при первом
+ * обращении, поэтому открытие файла любого размера занимает постоянное время.
+ */
+template <typename T>
+class vector_view {
+    static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable elements can be mapped");
+
+  public:
+    using size_type = size_t;
+    using value_type = T;
+    using difference_type = ptrdiff_t;
+    using const_reference = const T&;
+    using const_pointer = const T*;
+    using const_iterator = const T*;
+
+    vector_view() : base_(nullptr), mappedSize_(0), size_(0) {}
+
+    ~vector_view() {
+      close();
+    }
+
+    vector_view(const vector_view&) = delete;
+
+    vector_view& operator = (const vector_view&) = delete;
+
+    vector_view(vector_view&& other) noexcept : vector_view() {
+      swap(other);
+    }
+
+    vector_view& operator = (vector_view&& other) noexcept {
+      swap(other);
+      return *this;
+    }
+
+    /**
+     * @brief Отображение файла вектора.
+     * @param path - путь к файлу, записанному saveVector для того же типа элементов.
+     * @return true, если файл отображен.
+     */
+    bool open(const char* path) {
+      close();
+      base_ = detail::mapVectorFile(path, sizeof(T), alignof(T), size_, mappedSize_);
+      if(base_ == nullptr)
+        size_ = 0;
+      return base_ != nullptr;
+    }
+
+    /**
+     * @brief Снятие отображения, указатели на элементы становятся недействительными.
+     */
+    void close() {
+      if(base_ != nullptr)
+        detail::unmapVectorFile(base_, mappedSize_);
+      base_ = nullptr;
+      mappedSize_ = 0;
+      size_ = 0;
+    }
+
+    bool is_open() const {
+      return base_ != nullptr;
+    }
+
+    void swap(vector_view& other) {
+      std::swap(base_, other.base_);
+      std::swap(mappedSize_, other.mappedSize_);
+      std::swap(size_, other.size_);
+    }
+
+    size_type size() const {
+      return size_;
+    }
+
+    bool empty() const {
+      return size_ == 0;
+    }
+
+    const T* data() const {
+      return base_ != nullptr ? reinterpret_cast<const T*>(base_ + detail::vectorFilePayloadOffset()) : nullptr;
+    }
+
+    const T& operator [] (size_type pos) const {
+      return data()[pos];
+    }
+
+    const T& at(size_type pos) const {
+      if (pos >= size_)
+        throw std::out_of_range("Out of scope");
+      else
+        return data()[pos];
+    }
+
+    const_iterator begin() const {
+      return data();
+    }
+
+    const_iterator end() const {
+      return data() + size_;
+    }
+
+    const_iterator cbegin() const {
+      return begin();
+    }
+
+    const_iterator cend() const {
+      return end();
+    }
+
+  private:
+    ///< Начало отображения (заголовок файла).
+    const uint8_t* base_;
+
+    ///< Размер отображения.
+    size_t mappedSize_;
+
+    ///< Количество элементов.
+    size_type size_;
+};
+
+/**
+ * @brief Загрузка вектора из файла saveVector в память процесса (копированием данных).
+ * @param path - путь к файлу.
+ * @param vec - вектор, содержимое которого заменяется данными файла.
+ * @return true, если файл прочитан.
+ */
+template <typename T, typename A, typename G>
+bool loadVector(const char* path, vector<T, A, G>& vec) {
+  vector_view<T> view;
+  if(!view.open(path))
+    return false;
+
+  // Элементы создаются копированием из отображения, без предварительного создания по умолчанию.
+  vec.assign(view.begin(), view.end());
+  return true;
+}
+
+}
@@ -1,160 +1,242 @@
 #include "../inc/custom_heap.h"
+#include "../inc/heap_profiler.h"
+#include "heap_region.h"
 
-#include <stdint.h>
-#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-namespace custom {
+#include <mutex>
 
-///< Описатель блока памяти кучи.
-struct mcb_t {
-  mcb_t* nextMcb; // Указатель на следующий блок.
-  size_t size;    // Размер блока.
-};
+namespace custom {
 
-///< Минимальный размер остатка при разбиении блока.
-static constexpr size_t MIN_BLOCK_SIZE = sizeof(mcb_t) * 2;
+static_assert(HEAP_SIZE % heap_region::SLAB_PAGE_SIZE == 0, "Heap size must be a multiple of slab page size");
 
 /**
- * @brief Вставка блока в цепочку свободных блоков, а так-же слияние свободных блоков.
- * @param block - блок, который необходимо добавить в цепочку.
+ * @brief Отображение файла кучи в память.
+ * @param fd - дескриптор файла.
+ * @param size - размер отображения.
+ * @param hint - желаемый адрес отображения (NULL - любой).
+ * @return адрес отображения или NULL.
  */
-static void insertMcbIntoFreeChunk(mcb_t* block);
+static uint8_t* mapHeapFile(int fd, size_t size, void* hint);
 
 /**
- * @brief Инициализация кучи.
+ * @brief Поиск области кучи, которой принадлежит указатель.
+ * @param ptr - указатель на блок памяти.
+ * @return область или NULL, если указатель не принадлежит ни одной из куч.
  */
-static void heapInit();
+static heap_region* regionOf(const void* ptr);
 
+/**
+ * @brief Закрытие файла кучи, вызывается под heapMutex.
+ */
+static void closeFile();
 
-///< Память для кучи.
-static uint8_t heap[HEAP_SIZE];
 
-///< Начальный блок в цепочке свободных.
-static mcb_t beginMcb;
+///< Количество указателей, передаваемых в область за один вызов free_batch.
+static constexpr size_t FREE_BATCH_CHUNK = 64;
 
-///< Указатель на конечный блок в цепочке свободных.
-static mcb_t* endMcb = NULL;
+///< Память для кучи в памяти процесса.
+alignas(heap_region::SLAB_PAGE_SIZE) static uint8_t staticHeap[HEAP_SIZE];
 
-///< Размер свободного места в куче.
-static size_t freeBytes = HEAP_SIZE;
+///< Куча в памяти процесса.
+static heap_region staticRegion(staticHeap, HEAP_SIZE);
 
+///< Куча в файле (пустая область, если файл не открыт).
+static heap_region fileRegion(NULL, 0);
 
-void* malloc(size_t size) {
-  void* ptr = NULL;
+///< Текущая область кучи, из которой выделяется память.
+static heap_region* heap = &staticRegion;
 
-  // Инициализация кучи.
-  if(endMcb == NULL)
-    heapInit();
+///< Мьютекс кучи: все пользователи кучи (аллокаторы, контейнеры, пул кадров) работают через него.
+static std::mutex heapMutex;
 
-  if(size > 0)
-    size += sizeof(mcb_t);
 
-  if((size > 0) && (size <= freeBytes))
-  {
-    // Итерирование по списку свободных блоков, до нахождения первого с большим либо равным размером.
-    mcb_t* prevMcb = &beginMcb;
-    mcb_t* curMcb  = beginMcb.nextMcb;
-    while((curMcb->size < size) && (curMcb->nextMcb != NULL)) {
-      prevMcb = curMcb;
-      curMcb  = curMcb->nextMcb;
-    }
+CUSTOM_PROFILED void* malloc(size_t size) {
+  std::lock_guard<std::mutex> lock(heapMutex);
+  void* ptr = heap->malloc(size);
+  profiler::recordAlloc(ptr, size);
+  return ptr;
+}
 
-    // Блок нужного размера найден.
-    if(curMcb != endMcb) {
-      // Указатель на выделенный блок памяти.
-      ptr = static_cast<void*>((reinterpret_cast<uint8_t*>(prevMcb->nextMcb)) + sizeof(mcb_t));
+void free(void* ptr) {
+  // Блок возвращается в ту кучу, из которой выделен, чужие указатели отбрасываются.
+  std::lock_guard<std::mutex> lock(heapMutex);
+  heap_region* region = regionOf(ptr);
+  if(region != NULL) {
+    profiler::recordFree(ptr);
+    region->free(ptr);
+  }
+}
 
-      // Необходимо исключить этот блок из списка свободных.
-      prevMcb->nextMcb = curMcb->nextMcb;
+void free_sized(void* ptr, size_t size) {
+  std::lock_guard<std::mutex> lock(heapMutex);
+  heap_region* region = regionOf(ptr);
+  if(region != NULL) {
+    profiler::recordFree(ptr);
+    region->free_sized(ptr, size);
+  }
+}
 
-      // Если блок больше требуемого размера производится разбиения на два блока.
-      if((curMcb->size - size) > MIN_BLOCK_SIZE)
-      {
-        // Создание нового блока содержащего остаток памяти от разбиения.
-        mcb_t* newMcb = reinterpret_cast<mcb_t*>((reinterpret_cast<uint8_t*>(curMcb) + size));
-        newMcb->size = curMcb->size - size;
-        curMcb->size = size;
+CUSTOM_PROFILED size_t malloc_batch(size_t size, size_t count, void** out) {
+  std::lock_guard<std::mutex> lock(heapMutex);
+  size_t done = heap->malloc_batch(size, count, out);
+  for(size_t i = 0; i < done; ++i)
+    profiler::recordAlloc(out[i], size);
+  return done;
+}
 
-        // Помещение нового блока в список свободных.
-        insertMcbIntoFreeChunk(newMcb);
+void free_batch(void* const* ptrs, size_t count) {
+  // Указатели каждой из куч передаются ей отдельными пакетами.
+  std::lock_guard<std::mutex> lock(heapMutex);
+  for(heap_region* region: {&staticRegion, &fileRegion}) {
+    if(region->base() == NULL)
+      continue;
+
+    void* chunk[FREE_BATCH_CHUNK];
+    size_t used = 0;
+    for(size_t i = 0; i < count; ++i) {
+      if((ptrs[i] == NULL) || !region->contains(ptrs[i]))
+        continue;
+
+      profiler::recordFree(ptrs[i]);
+      chunk[used++] = ptrs[i];
+      if(used == FREE_BATCH_CHUNK) {
+        region->free_batch(chunk, used);
+        used = 0;
       }
-
-      freeBytes -= curMcb->size;
-      curMcb->nextMcb = NULL;
     }
+    if(used > 0)
+      region->free_batch(chunk, used);
   }
-  return ptr;
 }
 
-void free(void* ptr) {
-  if(ptr != NULL) {
-    // Вычисление указателя на mcb.
-    uint8_t* bytePtr = reinterpret_cast<uint8_t*>(ptr);
-    bytePtr -= sizeof(mcb_t);
-    mcb_t* mcb = reinterpret_cast<mcb_t*>(bytePtr);
+size_t getUsableSize(void* ptr) {
+  std::lock_guard<std::mutex> lock(heapMutex);
+  heap_region* region = regionOf(ptr);
+  return (region != NULL) ? region->getUsableSize(ptr) : 0;
+}
 
-    freeBytes += mcb->size;
+size_t getFreeHeapSize() {
+  std::lock_guard<std::mutex> lock(heapMutex);
+  return heap->getFreeSize();
+}
 
-    // Возврат куска памяти в цепочку свободных.
-    if(mcb->nextMcb == NULL)
-      insertMcbIntoFreeChunk(mcb);
-  }
+bool isHeapPointer(const void* ptr) {
+  std::lock_guard<std::mutex> lock(heapMutex);
+  return heap->contains(ptr);
 }
 
-size_t getFreeHeapSize() {
-  return freeBytes;
+size_t getHeapSize() {
+  std::lock_guard<std::mutex> lock(heapMutex);
+  return heap->size();
 }
 
-static void heapInit() {
-  // Инициализация начального блока списка свободных.
-  beginMcb.nextMcb = reinterpret_cast<mcb_t*>(heap);
-  beginMcb.size = 0;
+bool openHeapFile(const char* path, size_t size) {
+  std::lock_guard<std::mutex> lock(heapMutex);
+  closeFile();
 
-  // Блок обозначающий конец кучи endMcb располагается в конце массива.
-  uint8_t* heapEnd = heap + HEAP_SIZE - sizeof(mcb_t);
-  endMcb = reinterpret_cast<mcb_t*>(heapEnd);
-  endMcb->size = 0;
-  endMcb->nextMcb = NULL;
+  int fd = ::open(path, O_RDWR | O_CREAT, 0644);
+  if(fd < 0)
+    return false;
 
-  // Первый свободный блок, содержащий всю память выделенную под кучу минус endMcb.
-  mcb_t* fisrtFreeMcb = reinterpret_cast<mcb_t*>(heap);
-  fisrtFreeMcb->size = HEAP_SIZE - sizeof(mcb_t);
-  fisrtFreeMcb->nextMcb = endMcb;
+  struct stat st;
+  if(fstat(fd, &st) != 0) {
+    ::close(fd);
+    return false;
+  }
 
-  // Куча уже содержит endMcb.
-  freeBytes -= sizeof(mcb_t);
-}
+  // Новый файл получает размер, кратный странице слэба.
+  bool created = (st.st_size == 0);
+  if(created) {
+    size = (size + heap_region::SLAB_PAGE_SIZE - 1) / heap_region::SLAB_PAGE_SIZE * heap_region::SLAB_PAGE_SIZE;
+    if((size == 0) || (ftruncate(fd, static_cast<off_t>(size)) != 0)) {
+      ::close(fd);
+      return false;
+    }
+  }
+  else
+    size = static_cast<size_t>(st.st_size);
 
-static void insertMcbIntoFreeChunk(mcb_t* mcb) {
-  // Итерирование по цепочке блоков до нахождения блока с большим адресом.
-  mcb_t* it;
-  for(it = &beginMcb; it->nextMcb < mcb; it = it->nextMcb)
-    ;
+  uint8_t* base = mapHeapFile(fd, size, NULL);
+  if(base == NULL) {
+    ::close(fd);
+    return false;
+  }
 
-  // Если конец предыдущего блока совпадает с началом текущего, блоки объединяются.
-  uint8_t* bytePtr = reinterpret_cast<uint8_t*>(it);
-  if((bytePtr + it->size) == reinterpret_cast<uint8_t*>(mcb)) {
-    it->size += mcb->size;
-    mcb = it;
+  heap_region region(base, size);
+  if(created)
+    region.format();
+  else if(!region.isFormatted()) {
+    munmap(base, size);
+    ::close(fd);
+    return false;
   }
 
-  // Если конец текущего блока совпадает с началом следующего, блоки объединяются.
-  bytePtr = reinterpret_cast<uint8_t*>(mcb);
-  if((bytePtr + mcb->size) == reinterpret_cast<uint8_t*>(it->nextMcb)) {
-    if(it->nextMcb != endMcb)
-    {
-      mcb->size += it->nextMcb->size;
-      mcb->nextMcb = it->nextMcb->nextMcb;
+  // Существующая куча переотображается по адресу создания, чтобы указатели внутри нее остались верными.
+  uint8_t* formattedBase = reinterpret_cast<uint8_t*>(region.formattedBase());
+  if(formattedBase != base) {
+    uint8_t* fixedBase = mapHeapFile(fd, size, formattedBase);
+    if(fixedBase == formattedBase) {
+      munmap(base, size);
+      region.attach(fixedBase, size);
     }
-    else
-      mcb->nextMcb = endMcb;
+    else if(fixedBase != NULL)
+      munmap(fixedBase, size);
   }
-  else
-    mcb->nextMcb = it->nextMcb;
+  ::close(fd);
+
+  fileRegion = region;
+  heap = &fileRegion;
+  return true;
+}
+
+void closeHeapFile() {
+  std::lock_guard<std::mutex> lock(heapMutex);
+  closeFile();
+}
+
+bool isHeapRelocated() {
+  std::lock_guard<std::mutex> lock(heapMutex);
+  return heap->isFormatted() && (heap->formattedBase() != reinterpret_cast<uintptr_t>(heap->base()));
+}
+
+void setHeapRoot(void* ptr) {
+  std::lock_guard<std::mutex> lock(heapMutex);
+  heap->setRoot(ptr);
+}
+
+void* getHeapRoot() {
+  std::lock_guard<std::mutex> lock(heapMutex);
+  return heap->isFormatted() ? heap->getRoot() : NULL;
+}
+
+static void closeFile() {
+  if(heap != &fileRegion)
+    return;
+
+  msync(fileRegion.base(), fileRegion.size(), MS_SYNC);
+  munmap(fileRegion.base(), fileRegion.size());
+
+  fileRegion.attach(NULL, 0);
+  heap = &staticRegion;
+}
+
+static heap_region* regionOf(const void* ptr) {
+  if(ptr == NULL)
+    return NULL;
+  if(fileRegion.contains(ptr))
+    return &fileRegion;
+  if(staticRegion.contains(ptr))
+    return &staticRegion;
+  return NULL;
+}
 
-  // Если не было слияния предыдущего и текущего блоков.
-  if(it != mcb)
-    it->nextMcb = mcb;
+static uint8_t* mapHeapFile(int fd, size_t size, void* hint) {
+  void* base = mmap(hint, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  return (base != MAP_FAILED) ? static_cast<uint8_t*>(base) : NULL;
 }
 
 }
@@ -0,0 +1,136 @@
+#include "../inc/frame_pool.h"
+#include "../inc/custom_heap.h"
+
+namespace custom {
+
+///< Количество классов размера: 64, 128, ..., MAX_CLASS_SIZE.
+static constexpr size_t CLASSES = 7;
+
+static_assert((frame_pool::MIN_CLASS_SIZE << (CLASSES - 1)) == frame_pool::MAX_CLASS_SIZE, "Wrong number of size classes");
+
+/**
+ * @brief Свободные блоки потока, при завершении потока возвращаются в кучу.
+ */
+struct frame_cache_t {
+  ///< Свободный блок, указатель на следующий хранится в самом блоке.
+  struct block_t {
+    block_t* next;
+  };
+
+  block_t* freeBlocks[CLASSES] = {};
+
+  ///< Количество блоков в списках freeBlocks.
+  size_t freeCounts[CLASSES] = {};
+
+  ~frame_cache_t();
+};
+
+/**
+ * @brief Заголовок перед каждым блоком: откуда выделена память блока.
+ *
+ * Происхождение записывается при выделении, так как по адресу его не определить:
+ * после openHeapFile блоки статической кучи уже не относятся к текущей куче.
+ */
+struct alignas(max_align_t) block_header_t {
+  bool fromHeap; ///< true - блок выделен в кастомной куче, false - глобальным operator new.
+};
+
+/**
+ * @brief Выдать номер класса для блока размера size.
+ */
+static size_t classOf(size_t size);
+
+/**
+ * @brief Выделение памяти в куче, при ее исчерпании - глобальным operator new.
+ */
+static void* heapAllocate(size_t size);
+
+/**
+ * @brief Освобождение памяти, выделенной heapAllocate, туда, откуда она выделена.
+ */
+static void heapFree(void* ptr);
+
+
+///< Свободные блоки текущего потока.
+static thread_local frame_cache_t frameCache;
+
+
+void* frame_pool::allocate(size_t size) {
+  if(size > MAX_CLASS_SIZE)
+    return heapAllocate(size);
+
+  size_t cls = classOf(size);
+  frame_cache_t::block_t* block = frameCache.freeBlocks[cls];
+  if(block != nullptr) {
+    frameCache.freeBlocks[cls] = block->next;
+    --frameCache.freeCounts[cls];
+    return block;
+  }
+  return heapAllocate(MIN_CLASS_SIZE << cls);
+}
+
+void frame_pool::deallocate(void* ptr, size_t size) {
+  if(ptr == nullptr)
+    return;
+
+  if(size > MAX_CLASS_SIZE) {
+    heapFree(ptr);
+    return;
+  }
+
+  size_t cls = classOf(size);
+  if(frameCache.freeCounts[cls] >= MAX_CACHED_BLOCKS) {
+    heapFree(ptr);
+    return;
+  }
+
+  auto block = static_cast<frame_cache_t::block_t*>(ptr);
+  block->next = frameCache.freeBlocks[cls];
+  frameCache.freeBlocks[cls] = block;
+  ++frameCache.freeCounts[cls];
+}
+
+void frame_pool::trim() {
+  for(size_t cls = 0; cls < CLASSES; ++cls) {
+    auto& head = frameCache.freeBlocks[cls];
+    while(head != nullptr) {
+      auto block = head;
+      head = block->next;
+      heapFree(block);
+    }
+    frameCache.freeCounts[cls] = 0;
+  }
+}
+
+frame_cache_t::~frame_cache_t() {
+  frame_pool::trim();
+}
+
+static size_t classOf(size_t size) {
+  size_t cls = 0;
+  while((frame_pool::MIN_CLASS_SIZE << cls) < size)
+    ++cls;
+  return cls;
+}
+
+static void* heapAllocate(size_t size) {
+  size += sizeof(block_header_t);
+  void* ptr = custom::malloc(size);
+  bool fromHeap = ptr != nullptr;
+  if(!fromHeap)
+    ptr = ::operator new(size);
+
+  auto header = ::new (ptr) block_header_t;
+  header->fromHeap = fromHeap;
+  return header + 1;
+}
+
+static void heapFree(void* ptr) {
+  auto header = static_cast<block_header_t*>(ptr) - 1;
+  if(header->fromHeap)
+    custom::free(header);
+  else
+    ::operator delete(header);
+}
+
+}
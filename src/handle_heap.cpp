@@ -0,0 +1,230 @@
+#include "../inc/handle_heap.h"
+
+#include <string.h>
+
+namespace custom {
+
+constexpr handle_heap::handle handle_heap::INVALID_HANDLE;
+constexpr unsigned handle_heap::INDEX_BITS;
+
+///< Заголовок блока, блоки следуют друг за другом без промежутков.
+struct handle_heap::block_t {
+  size_t size;   // Полный размер блока с заголовком.
+  handle owner;  // Дескриптор блока, INVALID_HANDLE - свободный блок.
+  uint32_t pad;  // Выравнивание заголовка до 16 байт.
+};
+
+///< Выравнивание блоков (равно размеру заголовка).
+static constexpr size_t BLOCK_ALIGN = 16;
+
+///< Признак конца списка свободных записей таблицы дескрипторов.
+static constexpr size_t NO_ENTRY = static_cast<size_t>(-1);
+
+///< Маска номера записи в дескрипторе.
+static constexpr handle_heap::handle INDEX_MASK = (1u << handle_heap::INDEX_BITS) - 1;
+
+///< Наибольшее количество записей таблицы дескрипторов.
+static constexpr size_t MAX_ENTRIES = INDEX_MASK;
+
+///< Маска поколения (поколение занимает биты дескриптора выше номера записи).
+static constexpr uint32_t GENERATION_MASK = ~INDEX_MASK >> handle_heap::INDEX_BITS;
+
+/**
+ * @brief Выдать номер записи таблицы по дескриптору.
+ */
+static size_t indexOf(handle_heap::handle h);
+
+static_assert(sizeof(handle_heap::handle) == sizeof(uint32_t), "Handle must fit block header");
+
+
+handle_heap::handle_heap(void* memory, size_t size) :
+  heap_(static_cast<uint8_t*>(memory)), size_(size / BLOCK_ALIGN * BLOCK_ALIGN), freeBytes_(size_), freeEntry_(NO_ENTRY) {
+  static_assert(sizeof(block_t) == BLOCK_ALIGN, "Block header size must be equal to block alignment");
+  if(size_ > 0)
+    makeFree(0, size_);
+}
+
+handle_heap::handle handle_heap::allocate(size_t size) {
+  size = (sizeof(block_t) + size + BLOCK_ALIGN - 1) / BLOCK_ALIGN * BLOCK_ALIGN;
+  if(size > freeBytes_)
+    return INVALID_HANDLE;
+
+  size_t offset = findFree(size);
+  if(offset == size_) {
+    // Памяти достаточно, но она раздроблена.
+    compact();
+    offset = findFree(size);
+    if(offset == size_)
+      return INVALID_HANDLE;
+  }
+
+  // Запись таблицы дескрипторов берется из списка свободных либо добавляется.
+  size_t index = freeEntry_;
+  if(index == NO_ENTRY) {
+    if(entries_.size() >= MAX_ENTRIES)
+      return INVALID_HANDLE;
+    index = entries_.size();
+    entries_.push_back(entry_t{0, 0, 0, false});
+  }
+  else
+    freeEntry_ = entries_[index].offset;
+
+  // Остаток участка, в который помещается заголовок, становится свободным блоком.
+  block_t* block = blockAt(offset);
+  size_t rest = block->size - size;
+  if(rest >= sizeof(block_t))
+    makeFree(offset + size, rest);
+  else
+    size = block->size;
+
+  entry_t& entry = entries_[index];
+  block->size = size;
+  block->owner = (entry.generation << INDEX_BITS) | static_cast<handle>(index + 1);
+  freeBytes_ -= size;
+
+  entry.offset = offset;
+  entry.pins = 0;
+  entry.used = true;
+  return block->owner;
+}
+
+bool handle_heap::release(handle h) {
+  // Закрепленный блок не освобождается: его адрес еще используется.
+  entry_t* entry = entryOf(h);
+  if((entry == nullptr) || (entry->pins > 0))
+    return false;
+
+  block_t* block = blockAt(entry->offset);
+  block->owner = INVALID_HANDLE;
+  freeBytes_ += block->size;
+
+  entry->offset = freeEntry_;
+  entry->generation = (entry->generation + 1) & GENERATION_MASK;
+  entry->used = false;
+  freeEntry_ = indexOf(h);
+  return true;
+}
+
+void* handle_heap::pin(handle h) {
+  entry_t* entry = entryOf(h);
+  if(entry == nullptr)
+    return nullptr;
+
+  ++entry->pins;
+  return heap_ + entry->offset + sizeof(block_t);
+}
+
+void handle_heap::unpin(handle h) {
+  entry_t* entry = entryOf(h);
+  if((entry != nullptr) && (entry->pins > 0))
+    --entry->pins;
+}
+
+size_t handle_heap::getUsableSize(handle h) const {
+  const entry_t* entry = entryOf(h);
+  if(entry == nullptr)
+    return 0;
+  return blockAt(entry->offset)->size - sizeof(block_t);
+}
+
+void handle_heap::compact() {
+  size_t to = 0;
+  size_t offset = 0;
+  while(offset < size_) {
+    block_t* block = blockAt(offset);
+    size_t size = block->size;
+
+    if(block->owner != INVALID_HANDLE) {
+      entry_t& entry = entries_[indexOf(block->owner)];
+      if(entry.pins > 0) {
+        // Закрепленный блок остается на месте, участок перед ним становится свободным блоком.
+        if(to < offset)
+          makeFree(to, offset - to);
+        to = offset + size;
+      }
+      else {
+        if(to < offset) {
+          memmove(heap_ + to, block, size);
+          entry.offset = to;
+        }
+        to += size;
+      }
+    }
+
+    offset += size;
+  }
+
+  if(to < size_)
+    makeFree(to, size_ - to);
+}
+
+size_t handle_heap::getFreeSize() const {
+  return freeBytes_;
+}
+
+size_t handle_heap::getLargestFreeBlock() const {
+  size_t largest = 0;
+  size_t run = 0;
+  for(size_t offset = 0; offset < size_; offset += blockAt(offset)->size) {
+    if(blockAt(offset)->owner == INVALID_HANDLE) {
+      run += blockAt(offset)->size;
+      if(run > largest)
+        largest = run;
+    }
+    else
+      run = 0;
+  }
+  return largest > sizeof(block_t) ? largest - sizeof(block_t) : 0;
+}
+
+handle_heap::block_t* handle_heap::blockAt(size_t offset) const {
+  return reinterpret_cast<block_t*>(heap_ + offset);
+}
+
+handle_heap::entry_t* handle_heap::entryOf(handle h) {
+  return const_cast<entry_t*>(static_cast<const handle_heap*>(this)->entryOf(h));
+}
+
+const handle_heap::entry_t* handle_heap::entryOf(handle h) const {
+  // Дескриптор действителен, если запись занята и ее поколение совпадает с поколением дескриптора.
+  size_t index = indexOf(h);
+  if((h == INVALID_HANDLE) || (index >= entries_.size()))
+    return nullptr;
+
+  const entry_t& entry = entries_[index];
+  if(!entry.used || (entry.generation != (h >> INDEX_BITS)))
+    return nullptr;
+  return &entry;
+}
+
+size_t handle_heap::findFree(size_t size) {
+  for(size_t offset = 0; offset < size_; offset += blockAt(offset)->size) {
+    block_t* block = blockAt(offset);
+    if(block->owner != INVALID_HANDLE)
+      continue;
+
+    // Слияние со следующими свободными блоками.
+    size_t next = offset + block->size;
+    while((next < size_) && (blockAt(next)->owner == INVALID_HANDLE)) {
+      block->size += blockAt(next)->size;
+      next = offset + block->size;
+    }
+
+    if(block->size >= size)
+      return offset;
+  }
+  return size_;
+}
+
+void handle_heap::makeFree(size_t offset, size_t size) {
+  block_t* block = blockAt(offset);
+  block->size = size;
+  block->owner = INVALID_HANDLE;
+  block->pad = 0;
+}
+
+static size_t indexOf(handle_heap::handle h) {
+  return static_cast<size_t>(h & INDEX_MASK) - 1;
+}
+
+}
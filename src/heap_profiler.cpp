@@ -0,0 +1,213 @@
+#include "../inc/heap_profiler.h"
+
+#include <execinfo.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace custom {
+namespace profiler {
+
+///< Стек вызова семпла.
+using stack_t = std::vector<void*>;
+
+///< Статистика семплов одного стека.
+struct stats_t {
+  size_t liveCount;  // Количество живых семплов.
+  size_t liveBytes;  // Размер живых семплов.
+  size_t allocCount; // Количество семплов за все время.
+  size_t allocBytes; // Размер семплов за все время.
+};
+
+///< Живой семпл.
+struct sample_t {
+  stats_t* stats; // Статистика стека, которому принадлежит семпл.
+  size_t size;    // Размер блока.
+};
+
+///< Максимальная глубина сохраняемого стека.
+static constexpr int MAX_DEPTH = 32;
+
+///< Количество пропускаемых кадров: recordAlloc и точка входа кучи или аллокатора, вызвавшая его.
+static constexpr int SKIP_DEPTH = 2;
+
+/**
+ * @brief Выбор количества байт до следующего семпла (геометрическое распределение).
+ */
+static void pickNextSample();
+
+/**
+ * @brief Оценка реального количества объектов по семплам.
+ * @param count - количество семплов.
+ * @param bytes - размер семплов.
+ * @return оценка количества объектов.
+ */
+static double unsample(size_t count, size_t bytes);
+
+
+///< Мьютекс профилировщика: кучу и аллокаторы-пулы вызывают из разных потоков.
+static std::mutex profilerMutex;
+
+///< Средний интервал между семплами, байт (читается без блокировки на быстром пути).
+static std::atomic<size_t> sampleRate(0);
+
+///< Количество живых семплов (читается без блокировки на быстром пути).
+static std::atomic<size_t> liveSampleCount(0);
+
+///< Количество байт до следующего семпла.
+static double bytesUntilSample = 0;
+
+///< Генератор интервалов.
+static std::mt19937_64 rng;
+
+///< Статистика по стекам.
+static std::map<stack_t, stats_t> profiles;
+
+///< Живые семплы.
+static std::unordered_map<void*, sample_t> liveSamples;
+
+
+void setSampleRate(size_t bytes) {
+  std::lock_guard<std::mutex> lock(profilerMutex);
+  sampleRate = bytes;
+  pickNextSample();
+}
+
+size_t getSampleRate() {
+  return sampleRate;
+}
+
+void recordAlloc(void* ptr, size_t size) noexcept {
+  if((sampleRate.load(std::memory_order_relaxed) == 0) || (ptr == NULL))
+    return;
+
+  std::lock_guard<std::mutex> lock(profilerMutex);
+  if(sampleRate == 0)
+    return;
+
+  // Быстрый путь: семпл берется не чаще одного раза на sampleRate байт в среднем.
+  bytesUntilSample -= static_cast<double>(size);
+  if(bytesUntilSample > 0)
+    return;
+  pickNextSample();
+
+  void* frames[MAX_DEPTH + SKIP_DEPTH];
+  int depth = backtrace(frames, MAX_DEPTH + SKIP_DEPTH);
+
+  // Семпл, для которого не хватило памяти, отбрасывается: учет не должен ломать выделение.
+  try {
+    stack_t stack(frames + std::min(depth, SKIP_DEPTH), frames + depth);
+    stats_t& stats = profiles.emplace(std::move(stack), stats_t{0, 0, 0, 0}).first->second;
+    liveSamples[ptr] = sample_t{&stats, size};
+    liveSampleCount = liveSamples.size();
+
+    stats.liveCount++;
+    stats.liveBytes += size;
+    stats.allocCount++;
+    stats.allocBytes += size;
+  }
+  catch(...) {
+  }
+}
+
+void recordFree(void* ptr) noexcept {
+  if(liveSampleCount.load(std::memory_order_relaxed) == 0)
+    return;
+
+  std::lock_guard<std::mutex> lock(profilerMutex);
+  auto it = liveSamples.find(ptr);
+  if(it == liveSamples.end())
+    return;
+
+  it->second.stats->liveCount--;
+  it->second.stats->liveBytes -= it->second.size;
+  liveSamples.erase(it);
+  liveSampleCount = liveSamples.size();
+}
+
+void dumpHeapProfile(std::ostream& os) {
+  std::lock_guard<std::mutex> lock(profilerMutex);
+  stats_t total{0, 0, 0, 0};
+  for(const auto& it: profiles) {
+    total.liveCount += it.second.liveCount;
+    total.liveBytes += it.second.liveBytes;
+    total.allocCount += it.second.allocCount;
+    total.allocBytes += it.second.allocBytes;
+  }
+
+  // Значения не масштабируются, pprof сам восстанавливает их по интервалу heap_v2.
+  os << "heap profile: " << total.liveCount << ": " << total.liveBytes
+     << " [" << total.allocCount << ": " << total.allocBytes << "] @ heap_v2/"
+     << sampleRate << "\n";
+
+  for(const auto& it: profiles) {
+    os << " " << it.second.liveCount << ": " << it.second.liveBytes
+       << " [" << it.second.allocCount << ": " << it.second.allocBytes << "] @";
+    for(auto frame: it.first)
+      os << " " << frame;
+    os << "\n";
+  }
+
+  // Карта памяти процесса нужна pprof для символизации адресов.
+  os << "\nMAPPED_LIBRARIES:\n";
+  std::ifstream maps("/proc/self/maps");
+  os << maps.rdbuf();
+}
+
+void dumpFoldedStacks(std::ostream& os, bool live) {
+  std::lock_guard<std::mutex> lock(profilerMutex);
+  for(const auto& it: profiles) {
+    size_t count = live ? it.second.liveCount : it.second.allocCount;
+    size_t bytes = live ? it.second.liveBytes : it.second.allocBytes;
+    if(count == 0)
+      continue;
+
+    // Кадры выводятся от корня стека к месту выделения.
+    const stack_t& stack = it.first;
+    char** symbols = backtrace_symbols(stack.data(), static_cast<int>(stack.size()));
+    for(size_t i = stack.size(); i > 0; --i) {
+      if(symbols != NULL)
+        os << symbols[i - 1];
+      else
+        os << stack[i - 1];
+      os << (i > 1 ? ";" : "");
+    }
+    ::free(symbols);
+
+    double objects = unsample(count, bytes);
+    os << " " << static_cast<size_t>(std::llround(objects * bytes / count)) << "\n";
+  }
+}
+
+void reset() {
+  std::lock_guard<std::mutex> lock(profilerMutex);
+  profiles.clear();
+  liveSamples.clear();
+  liveSampleCount = 0;
+}
+
+static void pickNextSample() {
+  if(sampleRate == 0)
+    return;
+
+  std::exponential_distribution<double> dist(1.0 / static_cast<double>(sampleRate));
+  bytesUntilSample = dist(rng);
+}
+
+static double unsample(size_t count, size_t bytes) {
+  // Вероятность попадания в семпл объекта среднего размера, как в pprof для heap_v2.
+  double size = static_cast<double>(bytes) / static_cast<double>(count);
+  double probability = 1.0 - std::exp(-size / static_cast<double>(sampleRate));
+  return static_cast<double>(count) / probability;
+}
+
+}
+}
@@ -0,0 +1,556 @@
+#include "heap_region.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+namespace custom {
+
+///< Описатель блока памяти кучи.
+struct heap_region::mcb_t {
+  offset_t nextMcb; // Смещение следующего блока.
+  size_t size;      // Размер блока.
+};
+
+///< Заголовок страницы слэба, располагается по выровненному адресу страницы.
+struct heap_region::page_t {
+  offset_t nextPage;  // Следующая страница того же класса размера.
+  offset_t freeSlot;  // Цепочка свободных слотов страницы.
+  size_t   slotSize;  // Размер слота (класс размера).
+  size_t   usedSlots; // Количество занятых слотов.
+};
+
+///< Классы размеров малых блоков, хранящихся без заголовка mcb_t.
+static constexpr size_t SLAB_CLASSES[] = {8, 16, 32, heap_region::SLAB_MAX_SIZE};
+
+///< Количество классов размеров.
+static constexpr size_t SLAB_CLASS_COUNT = sizeof(SLAB_CLASSES) / sizeof(SLAB_CLASSES[0]);
+
+///< Заголовок области, располагается в ее начале.
+struct heap_region::header_t {
+  uint64_t magic;                       // Признак размеченной области.
+  uint64_t version;                     // Версия формата области.
+  uint64_t base;                        // Адрес области при разметке.
+  size_t   size;                        // Размер области.
+  size_t   freeBytes;                   // Размер свободного места.
+  offset_t root;                        // Корневой объект.
+  offset_t endMcb;                      // Конечный блок в цепочке свободных.
+  mcb_t    beginMcb;                    // Начальный блок в цепочке свободных.
+  offset_t slabPages[SLAB_CLASS_COUNT]; // Списки страниц слэба по классам размеров.
+};
+
+///< Признак размеченной области.
+static constexpr uint64_t HEAP_MAGIC = 0x5041454854535543; // "CUSTHEAP"
+
+///< Версия формата области.
+static constexpr uint64_t HEAP_VERSION = 1;
+
+///< Размер описателя блока mcb_t.
+static constexpr size_t MCB_SIZE = sizeof(size_t) * 2;
+
+///< Минимальный размер остатка при разбиении блока.
+static constexpr size_t MIN_BLOCK_SIZE = MCB_SIZE * 2;
+
+///< Количество крупных блоков, упорядочиваемых и вставляемых в список за один проход.
+static constexpr size_t FREE_BATCH_CHUNK = 64;
+
+/**
+ * @brief Определение класса размера малого блока.
+ * @param size - размер блока.
+ * @return индекс класса в SLAB_CLASSES.
+ */
+static size_t slabClass(size_t size);
+
+/**
+ * @brief Размер блока с заголовком mcb_t, кратный размеру заголовка.
+ * @param size - запрошенный размер.
+ */
+static size_t blockSizeOf(size_t size);
+
+
+void heap_region::attach(uint8_t* base, size_t size) {
+  heap_ = base;
+  size_ = size;
+}
+
+void heap_region::format() {
+  static_assert(sizeof(mcb_t) == MCB_SIZE, "Unexpected memory control block size");
+
+  // Заголовок и таблица страниц слэба занимают начало области.
+  size_t pages = size_ / SLAB_PAGE_SIZE;
+  offset_t first = (sizeof(header_t) + pages + MCB_SIZE - 1) / MCB_SIZE * MCB_SIZE;
+  memset(heap_, 0, first);
+
+  header_t* h = header();
+  h->magic = HEAP_MAGIC;
+  h->version = HEAP_VERSION;
+  h->base = reinterpret_cast<uintptr_t>(heap_);
+  h->size = size_;
+
+  // Блок обозначающий конец кучи endMcb располагается в конце области.
+  h->endMcb = size_ - sizeof(mcb_t);
+  mcb_t* endMcb = mcbAt(h->endMcb);
+  endMcb->size = 0;
+  endMcb->nextMcb = 0;
+
+  // Первый свободный блок, содержащий всю память области за вычетом служебной.
+  mcb_t* firstFreeMcb = mcbAt(first);
+  firstFreeMcb->size = h->endMcb - first;
+  firstFreeMcb->nextMcb = h->endMcb;
+
+  // Инициализация начального блока списка свободных.
+  h->beginMcb.nextMcb = first;
+  h->beginMcb.size = 0;
+
+  h->freeBytes = firstFreeMcb->size;
+}
+
+bool heap_region::isFormatted() const {
+  return (header()->magic == HEAP_MAGIC) && (header()->version == HEAP_VERSION) &&
+         (header()->size == size_);
+}
+
+void* heap_region::malloc(size_t size) {
+  void* ptr = NULL;
+  ensureFormatted();
+
+  // Малые блоки выделяются из слэба без заголовка, при неудаче - из общего списка.
+  if((size > 0) && (size <= SLAB_MAX_SIZE))
+    slabAllocBatch(size, 1, &ptr);
+
+  if(ptr == NULL)
+    ptr = blockAlloc(size);
+
+  return ptr;
+}
+
+void heap_region::free(void* ptr) {
+  if(ptr != NULL) {
+    page_t* page = slabPageOf(ptr);
+    if(page != NULL)
+      slabFree(page, ptr);
+    else
+      freeBlock(ptr);
+  }
+}
+
+void heap_region::free_sized(void* ptr, size_t size) {
+  if(ptr != NULL) {
+    // Крупные блоки никогда не выделяются из слэба, поиск страницы не требуется.
+    page_t* page = (size <= SLAB_MAX_SIZE) ? slabPageOf(ptr) : NULL;
+    if(page != NULL)
+      slabFree(page, ptr);
+    else
+      freeBlock(ptr);
+  }
+}
+
+size_t heap_region::malloc_batch(size_t size, size_t count, void** out) {
+  ensureFormatted();
+
+  if(size == 0)
+    return 0;
+
+  size_t done = 0;
+  if(size <= SLAB_MAX_SIZE)
+    done = slabAllocBatch(size, count, out);
+  return done + blockAllocBatch(size, count - done, out + done);
+}
+
+void heap_region::free_batch(void* const* ptrs, size_t count) {
+  // Малые блоки сразу возвращаются в страницы, остальные собираются в локальный буфер.
+  void* blocks[FREE_BATCH_CHUNK];
+  size_t used = 0;
+  for(size_t i = 0; i < count; ++i) {
+    if(ptrs[i] == NULL)
+      continue;
+
+    page_t* page = slabPageOf(ptrs[i]);
+    if(page != NULL)
+      slabFree(page, ptrs[i]);
+    else {
+      blocks[used++] = ptrs[i];
+      if(used == FREE_BATCH_CHUNK) {
+        freeBlocks(blocks, used);
+        used = 0;
+      }
+    }
+  }
+  freeBlocks(blocks, used);
+}
+
+size_t heap_region::getUsableSize(void* ptr) const {
+  if(ptr == NULL)
+    return 0;
+
+  page_t* page = slabPageOf(ptr);
+  if(page != NULL)
+    return page->slotSize;
+
+  mcb_t* mcb = reinterpret_cast<mcb_t*>(reinterpret_cast<uint8_t*>(ptr) - sizeof(mcb_t));
+  return mcb->size - sizeof(mcb_t);
+}
+
+size_t heap_region::getFreeSize() {
+  ensureFormatted();
+  return header()->freeBytes;
+}
+
+bool heap_region::contains(const void* ptr) const {
+  const uint8_t* bytePtr = static_cast<const uint8_t*>(ptr);
+  return (bytePtr >= heap_) && (bytePtr < heap_ + size_);
+}
+
+uintptr_t heap_region::formattedBase() const {
+  return static_cast<uintptr_t>(header()->base);
+}
+
+void heap_region::setRoot(void* ptr) {
+  ensureFormatted();
+  header()->root = (ptr != NULL) ? offsetOf(ptr) : 0;
+}
+
+void* heap_region::getRoot() const {
+  offset_t root = header()->root;
+  return (root != 0) ? heap_ + root : NULL;
+}
+
+heap_region::header_t* heap_region::header() const {
+  return reinterpret_cast<header_t*>(heap_);
+}
+
+bool* heap_region::slabTable() const {
+  return reinterpret_cast<bool*>(heap_ + sizeof(header_t));
+}
+
+heap_region::mcb_t* heap_region::mcbAt(offset_t offset) const {
+  return reinterpret_cast<mcb_t*>(heap_ + offset);
+}
+
+heap_region::page_t* heap_region::pageAt(offset_t offset) const {
+  return (offset != 0) ? reinterpret_cast<page_t*>(heap_ + offset) : NULL;
+}
+
+heap_region::offset_t heap_region::offsetOf(const void* ptr) const {
+  return static_cast<offset_t>(static_cast<const uint8_t*>(ptr) - heap_);
+}
+
+void heap_region::ensureFormatted() {
+  // Инициализация кучи.
+  if(header()->magic != HEAP_MAGIC)
+    format();
+}
+
+heap_region::mcb_t* heap_region::insertMcbIntoFreeChunk(mcb_t* mcb, mcb_t* from) {
+  // Итерирование по цепочке блоков до нахождения блока с большим адресом.
+  offset_t offset = offsetOf(mcb);
+  mcb_t* it;
+  for(it = from; it->nextMcb < offset; it = mcbAt(it->nextMcb))
+    ;
+
+  // Если конец предыдущего блока совпадает с началом текущего, блоки объединяются.
+  if((offsetOf(it) + it->size) == offset) {
+    it->size += mcb->size;
+    mcb = it;
+  }
+
+  // Если конец текущего блока совпадает с началом следующего, блоки объединяются.
+  offset_t nextOffset = it->nextMcb;
+  if((offsetOf(mcb) + mcb->size) == nextOffset) {
+    if(nextOffset != header()->endMcb)
+    {
+      mcb->size += mcbAt(nextOffset)->size;
+      mcb->nextMcb = mcbAt(nextOffset)->nextMcb;
+    }
+    else
+      mcb->nextMcb = nextOffset;
+  }
+  else
+    mcb->nextMcb = nextOffset;
+
+  // Если не было слияния предыдущего и текущего блоков.
+  if(it != mcb)
+    it->nextMcb = offsetOf(mcb);
+
+  return mcb;
+}
+
+void* heap_region::blockAlloc(size_t size) {
+  void* ptr = NULL;
+  header_t* h = header();
+
+  // Размер блока кратен размеру заголовка, чтобы все mcb_t были выровнены.
+  if(size > 0)
+    size = blockSizeOf(size);
+
+  if((size > 0) && (size <= h->freeBytes))
+  {
+    // Итерирование по списку свободных блоков, до нахождения первого с большим либо равным размером.
+    mcb_t* prevMcb = &h->beginMcb;
+    mcb_t* curMcb  = mcbAt(h->beginMcb.nextMcb);
+    while((curMcb->size < size) && (curMcb->nextMcb != 0)) {
+      prevMcb = curMcb;
+      curMcb  = mcbAt(curMcb->nextMcb);
+    }
+
+    // Блок нужного размера найден.
+    if(offsetOf(curMcb) != h->endMcb) {
+      // Указатель на выделенный блок памяти.
+      ptr = static_cast<void*>(reinterpret_cast<uint8_t*>(curMcb) + sizeof(mcb_t));
+
+      // Необходимо исключить этот блок из списка свободных.
+      prevMcb->nextMcb = curMcb->nextMcb;
+
+      // Если блок больше требуемого размера производится разбиения на два блока.
+      if((curMcb->size - size) > MIN_BLOCK_SIZE)
+      {
+        // Создание нового блока содержащего остаток памяти от разбиения.
+        mcb_t* newMcb = reinterpret_cast<mcb_t*>((reinterpret_cast<uint8_t*>(curMcb) + size));
+        newMcb->size = curMcb->size - size;
+        curMcb->size = size;
+
+        // Помещение нового блока в список свободных.
+        insertMcbIntoFreeChunk(newMcb, prevMcb);
+      }
+
+      h->freeBytes -= curMcb->size;
+      curMcb->nextMcb = 0;
+    }
+  }
+  return ptr;
+}
+
+void heap_region::freeBlock(void* ptr) {
+  // Вычисление указателя на mcb.
+  uint8_t* bytePtr = reinterpret_cast<uint8_t*>(ptr);
+  bytePtr -= sizeof(mcb_t);
+  mcb_t* mcb = reinterpret_cast<mcb_t*>(bytePtr);
+
+  header()->freeBytes += mcb->size;
+
+  // Возврат куска памяти в цепочку свободных.
+  if(mcb->nextMcb == 0)
+    insertMcbIntoFreeChunk(mcb, &header()->beginMcb);
+}
+
+void heap_region::freeBlocks(void** blocks, size_t count) {
+  if(count == 0)
+    return;
+
+  // Упорядоченные по адресу блоки вставляются в список за один проход.
+  std::sort(blocks, blocks + count);
+  mcb_t* hint = &header()->beginMcb;
+  for(size_t i = 0; i < count; ++i) {
+    mcb_t* mcb = reinterpret_cast<mcb_t*>(reinterpret_cast<uint8_t*>(blocks[i]) - sizeof(mcb_t));
+    header()->freeBytes += mcb->size;
+    if(mcb->nextMcb == 0)
+      hint = insertMcbIntoFreeChunk(mcb, hint);
+  }
+}
+
+size_t heap_region::blockAllocBatch(size_t size, size_t count, void** out) {
+  header_t* h = header();
+  size_t done = 0;
+  size_t blockSize = blockSizeOf(size);
+
+  // Один проход по списку свободных блоков, каждый блок отдает столько частей, сколько вмещает.
+  mcb_t* prevMcb = &h->beginMcb;
+  mcb_t* curMcb  = mcbAt(h->beginMcb.nextMcb);
+  while((done < count) && (offsetOf(curMcb) != h->endMcb)) {
+    size_t parts = std::min(count - done, curMcb->size / blockSize);
+    if(parts == 0) {
+      prevMcb = curMcb;
+      curMcb  = mcbAt(curMcb->nextMcb);
+      continue;
+    }
+
+    uint8_t* bytePtr = reinterpret_cast<uint8_t*>(curMcb);
+    size_t rest = curMcb->size - parts * blockSize;
+    offset_t nextMcb = curMcb->nextMcb;
+
+    // Остаток либо становится свободным блоком на месте текущего, либо отдается последней части.
+    size_t lastSize = blockSize;
+    if(rest > MIN_BLOCK_SIZE) {
+      mcb_t* restMcb = reinterpret_cast<mcb_t*>(bytePtr + parts * blockSize);
+      restMcb->size = rest;
+      restMcb->nextMcb = nextMcb;
+      prevMcb->nextMcb = offsetOf(restMcb);
+      curMcb = restMcb;
+    }
+    else {
+      lastSize += rest;
+      prevMcb->nextMcb = nextMcb;
+      curMcb = mcbAt(nextMcb);
+    }
+
+    for(size_t i = 0; i < parts; ++i) {
+      mcb_t* mcb = reinterpret_cast<mcb_t*>(bytePtr + i * blockSize);
+      mcb->size = (i + 1 == parts) ? lastSize : blockSize;
+      mcb->nextMcb = 0;
+      h->freeBytes -= mcb->size;
+      out[done++] = reinterpret_cast<uint8_t*>(mcb) + sizeof(mcb_t);
+    }
+  }
+  return done;
+}
+
+size_t heap_region::slabAllocBatch(size_t size, size_t count, void** out) {
+  size_t cls = slabClass(size);
+  size_t done = 0;
+
+  // Один проход по страницам класса, новые страницы добавляются в начало списка.
+  page_t* page = pageAt(header()->slabPages[cls]);
+  while(done < count) {
+    while((page != NULL) && (page->freeSlot == 0))
+      page = pageAt(page->nextPage);
+
+    if(page == NULL) {
+      page = slabNewPage(cls);
+      if(page == NULL)
+        break;
+    }
+
+    // Выдача слотов страницы подряд, счетчики обновляются один раз на страницу.
+    size_t taken = 0;
+    while((done < count) && (page->freeSlot != 0)) {
+      uint8_t* slot = heap_ + page->freeSlot;
+      out[done++] = slot;
+      page->freeSlot = *reinterpret_cast<offset_t*>(slot);
+      ++taken;
+    }
+    page->usedSlots += taken;
+    header()->freeBytes -= taken * page->slotSize;
+  }
+  return done;
+}
+
+heap_region::page_t* heap_region::slabNewPage(size_t cls) {
+  uint8_t* pagePtr = takePage();
+  if(pagePtr == NULL)
+    return NULL;
+
+  slabTable()[offsetOf(pagePtr) / SLAB_PAGE_SIZE] = true;
+
+  page_t* page = reinterpret_cast<page_t*>(pagePtr);
+  page->slotSize = SLAB_CLASSES[cls];
+  page->usedSlots = 0;
+  page->freeSlot = 0;
+
+  // Разметка страницы на слоты, цепочка строится от конца страницы к началу.
+  offset_t first = offsetOf(pagePtr) + sizeof(page_t);
+  size_t slots = (SLAB_PAGE_SIZE - sizeof(page_t)) / page->slotSize;
+  for(size_t i = slots; i > 0; --i) {
+    offset_t slot = first + (i - 1) * page->slotSize;
+    *reinterpret_cast<offset_t*>(heap_ + slot) = page->freeSlot;
+    page->freeSlot = slot;
+  }
+
+  // Слоты страницы считаются свободной памятью кучи, заголовок - нет.
+  header()->freeBytes += slots * page->slotSize;
+
+  page->nextPage = header()->slabPages[cls];
+  header()->slabPages[cls] = offsetOf(page);
+  return page;
+}
+
+void heap_region::slabFree(page_t* page, void* ptr) {
+  *reinterpret_cast<offset_t*>(ptr) = page->freeSlot;
+  page->freeSlot = offsetOf(ptr);
+  page->usedSlots--;
+  header()->freeBytes += page->slotSize;
+
+  if(page->usedSlots != 0)
+    return;
+
+  // Пустая страница возвращается в кучу, если в классе есть другие страницы.
+  offset_t* first = &header()->slabPages[slabClass(page->slotSize)];
+  offset_t* it = first;
+  while(*it != offsetOf(page))
+    it = &pageAt(*it)->nextPage;
+
+  if((it == first) && (page->nextPage == 0))
+    return;
+
+  *it = page->nextPage;
+  releasePage(page);
+}
+
+heap_region::page_t* heap_region::slabPageOf(const void* ptr) const {
+  if(!contains(ptr))
+    return NULL;
+
+  // Класс блока определяется по заголовку выровненной страницы.
+  size_t idx = offsetOf(ptr) / SLAB_PAGE_SIZE;
+  if(!slabTable()[idx])
+    return NULL;
+
+  return pageAt(idx * SLAB_PAGE_SIZE);
+}
+
+uint8_t* heap_region::takePage() {
+  header_t* h = header();
+  mcb_t* prevMcb = &h->beginMcb;
+  mcb_t* curMcb  = mcbAt(h->beginMcb.nextMcb);
+
+  // Поиск первого свободного блока, содержащего выровненную страницу, остатки
+  // от разбиения которого либо отсутствуют, либо могут стать свободными блоками.
+  for(; offsetOf(curMcb) != h->endMcb; prevMcb = curMcb, curMcb = mcbAt(curMcb->nextMcb)) {
+    offset_t start = offsetOf(curMcb);
+    offset_t end   = start + curMcb->size;
+    offset_t page  = (start + SLAB_PAGE_SIZE - 1) / SLAB_PAGE_SIZE * SLAB_PAGE_SIZE;
+
+    for(; page + SLAB_PAGE_SIZE <= end; page += SLAB_PAGE_SIZE) {
+      size_t head = page - start;
+      size_t tail = end - (page + SLAB_PAGE_SIZE);
+      if(((head != 0) && (head < MIN_BLOCK_SIZE)) || ((tail != 0) && (tail < MIN_BLOCK_SIZE)))
+        continue;
+
+      // Остаток перед страницей остается в списке свободных, иначе блок исключается.
+      offset_t nextMcb = curMcb->nextMcb;
+      if(head != 0)
+        curMcb->size = head;
+      else
+        prevMcb->nextMcb = nextMcb;
+
+      // Остаток после страницы становится отдельным свободным блоком.
+      if(tail != 0) {
+        mcb_t* tailMcb = mcbAt(page + SLAB_PAGE_SIZE);
+        tailMcb->size = tail;
+        tailMcb->nextMcb = nextMcb;
+        if(head != 0)
+          curMcb->nextMcb = offsetOf(tailMcb);
+        else
+          prevMcb->nextMcb = offsetOf(tailMcb);
+      }
+
+      h->freeBytes -= SLAB_PAGE_SIZE;
+      return heap_ + page;
+    }
+  }
+  return NULL;
+}
+
+void heap_region::releasePage(page_t* page) {
+  slabTable()[offsetOf(page) / SLAB_PAGE_SIZE] = false;
+
+  // Свободные слоты уже учтены в freeBytes, добавляется только заголовок и хвост страницы.
+  size_t slots = (SLAB_PAGE_SIZE - sizeof(page_t)) / page->slotSize;
+  header()->freeBytes += SLAB_PAGE_SIZE - slots * page->slotSize;
+
+  mcb_t* mcb = reinterpret_cast<mcb_t*>(page);
+  mcb->size = SLAB_PAGE_SIZE;
+  insertMcbIntoFreeChunk(mcb, &header()->beginMcb);
+}
+
+static size_t slabClass(size_t size) {
+  size_t cls = 0;
+  while(SLAB_CLASSES[cls] < size)
+    ++cls;
+  return cls;
+}
+
+static size_t blockSizeOf(size_t size) {
+  return (size + 2 * MCB_SIZE - 1) / MCB_SIZE * MCB_SIZE;
+}
+
+}
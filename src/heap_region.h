@@ -0,0 +1,209 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace custom {
+/**
+ * @brief Область памяти кучи.
+ *
+ * Заголовок, таблица страниц слэба и сами блоки располагаются внутри области,
+ * служебные структуры ссылаются друг на друга смещениями от ее начала. Поэтому
+ * размеченная область остается корректной после отображения по другому адресу.
+ */
+class heap_region {
+  public:
+    ///< Размер страницы слэба, байт (область и страницы выровнены на этот размер).
+    static constexpr size_t SLAB_PAGE_SIZE = 1024;
+
+    ///< Максимальный размер блока, выделяемого из слэба.
+    static constexpr size_t SLAB_MAX_SIZE = 64;
+
+    constexpr heap_region(uint8_t* base, size_t size) : heap_(base), size_(size) {}
+
+    /**
+     * @brief Привязка к другой области памяти.
+     * @param base - начало области, выровненное на SLAB_PAGE_SIZE.
+     * @param size - размер области, кратный SLAB_PAGE_SIZE.
+     */
+    void attach(uint8_t* base, size_t size);
+
+    /**
+     * @brief Разметка области: все содержимое становится свободной памятью.
+     */
+    void format();
+
+    /**
+     * @brief Проверка, размечена ли область.
+     */
+    bool isFormatted() const;
+
+    /**
+     * @brief Выделение памяти в области (см. custom::malloc).
+     */
+    void* malloc(size_t size);
+
+    /**
+     * @brief Освобождение памяти в области (см. custom::free).
+     */
+    void free(void* ptr);
+
+    /**
+     * @brief Освобождение памяти с известным размером блока (см. custom::free_sized).
+     */
+    void free_sized(void* ptr, size_t size);
+
+    /**
+     * @brief Выделение нескольких блоков одного размера (см. custom::malloc_batch).
+     */
+    size_t malloc_batch(size_t size, size_t count, void** out);
+
+    /**
+     * @brief Освобождение нескольких блоков (см. custom::free_batch).
+     */
+    void free_batch(void* const* ptrs, size_t count);
+
+    /**
+     * @brief Выдать реальный размер выделенного блока (см. custom::getUsableSize).
+     */
+    size_t getUsableSize(void* ptr) const;
+
+    /**
+     * @brief Выдать размер свободной памяти в области, без учета фрагментации.
+     */
+    size_t getFreeSize();
+
+    /**
+     * @brief Проверка принадлежности указателя области.
+     */
+    bool contains(const void* ptr) const;
+
+    uint8_t* base() const {
+      return heap_;
+    }
+
+    size_t size() const {
+      return size_;
+    }
+
+    /**
+     * @brief Выдать адрес, по которому область была размечена.
+     */
+    uintptr_t formattedBase() const;
+
+    /**
+     * @brief Сохранение корневого объекта области (хранится смещением).
+     */
+    void setRoot(void* ptr);
+
+    void* getRoot() const;
+
+  private:
+    struct mcb_t;
+    struct page_t;
+    struct header_t;
+
+    ///< Смещение от начала области, 0 - отсутствие блока.
+    using offset_t = size_t;
+
+    ///< Начало области.
+    uint8_t* heap_;
+
+    ///< Размер области.
+    size_t size_;
+
+    header_t* header() const;
+
+    bool* slabTable() const;
+
+    mcb_t* mcbAt(offset_t offset) const;
+
+    page_t* pageAt(offset_t offset) const;
+
+    offset_t offsetOf(const void* ptr) const;
+
+    /**
+     * @brief Разметка области при первом обращении.
+     */
+    void ensureFormatted();
+
+    /**
+     * @brief Вставка блока в цепочку свободных блоков, а так-же слияние свободных блоков.
+     * @param mcb - блок, который необходимо добавить в цепочку.
+     * @param from - свободный блок с меньшим адресом, с которого начинается поиск места вставки.
+     * @return свободный блок, содержащий вставленный блок после слияния.
+     */
+    mcb_t* insertMcbIntoFreeChunk(mcb_t* mcb, mcb_t* from);
+
+    /**
+     * @brief Выделение блока с заголовком mcb_t из списка свободных блоков.
+     * @param size - размер выделяемого блока памяти.
+     * @return указатель на выделенный блок памяти или NULL.
+     */
+    void* blockAlloc(size_t size);
+
+    /**
+     * @brief Освобождение блока, выделенного из списка свободных блоков (с заголовком mcb_t).
+     * @param ptr - указатель на удаляемый блок памяти.
+     */
+    void freeBlock(void* ptr);
+
+    /**
+     * @brief Освобождение нескольких блоков с заголовком mcb_t за один проход по списку свободных.
+     * @param blocks - указатели на удаляемые блоки, массив упорядочивается по адресу.
+     * @param count - количество блоков.
+     */
+    void freeBlocks(void** blocks, size_t count);
+
+    /**
+     * @brief Выделение нескольких блоков с заголовком mcb_t за один проход по списку свободных.
+     * @param size - размер выделяемых блоков.
+     * @param count - количество блоков.
+     * @param out - массив для указателей на выделенные блоки.
+     * @return количество выделенных блоков.
+     */
+    size_t blockAllocBatch(size_t size, size_t count, void** out);
+
+    /**
+     * @brief Выделение нескольких малых блоков одного размера за один проход по страницам класса.
+     * @param size - размер выделяемых блоков.
+     * @param count - количество блоков.
+     * @param out - массив для указателей на выделенные блоки.
+     * @return количество выделенных блоков.
+     */
+    size_t slabAllocBatch(size_t size, size_t count, void** out);
+
+    /**
+     * @brief Получение новой страницы слэба и разметка ее на слоты.
+     * @param cls - индекс класса размера.
+     * @return заголовок страницы или NULL, если страницу получить не удалось.
+     */
+    page_t* slabNewPage(size_t cls);
+
+    /**
+     * @brief Возврат малого блока в страницу слэба.
+     * @param page - страница, которой принадлежит блок.
+     * @param ptr - указатель на удаляемый блок памяти.
+     */
+    void slabFree(page_t* page, void* ptr);
+
+    /**
+     * @brief Поиск страницы слэба, которой принадлежит указатель.
+     * @param ptr - указатель на блок памяти.
+     * @return заголовок страницы или NULL, если блок выделен не из слэба.
+     */
+    page_t* slabPageOf(const void* ptr) const;
+
+    /**
+     * @brief Получение выровненной страницы из списка свободных блоков.
+     * @return указатель на начало страницы или NULL, если подходящего места нет.
+     */
+    uint8_t* takePage();
+
+    /**
+     * @brief Возврат пустой страницы в список свободных блоков.
+     * @param page - освобождаемая страница.
+     */
+    void releasePage(page_t* page);
+};
+}
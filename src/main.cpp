@@ -4,6 +4,7 @@
 #include "../inc/custom_allocator.h"
 #include "../inc/custom_vector.h"
 #include "../inc/factorial.h"
+#include "../inc/flat_map.h"
 #include "../inc/ver.h"
 
 constexpr int MAX_ELEMS = 10;
@@ -19,15 +20,20 @@ int main()
   using map_cust_t = std::map<int, int, std::less<int>, map_cust_alloc_t>;
   map_cust_t map2;
 
+  // Мап на отсортированных массивах с кастомным аллокатором.
+  using flat_map_cust_alloc_t = custom::fallback<custom::allocator<std::pair<const int, int>, MAX_ELEMS>,
+                                                 custom::allocator<std::pair<const int, int>, 0>>;
+  using flat_map_cust_t = custom::flat_map<int, int, std::less<int>, flat_map_cust_alloc_t>;
+  flat_map_cust_t map3;
+
   // Кастомный вектор со стандартным аллокатором.
   using cust_vec_t = custom::vector<int>;
   cust_vec_t vec1;
 
-  // Кастомный вектор с кастомным аллокатором.
-  using cust_vec_cust_alloc_t = custom::allocator<int, MAX_ELEMS>;
+  // Кастомный вектор с кастомным аллокатором, при исчерпании пула память берется из кастомной кучи.
+  using cust_vec_cust_alloc_t = custom::fallback<custom::allocator<int, MAX_ELEMS>, custom::allocator<int, 0>>;
   using cust_vec_cust_t = custom::vector<int, cust_vec_cust_alloc_t>;
   cust_vec_cust_t vec2;
-  vec2.reserve(MAX_ELEMS);
 
   // Кастомный вектор с кастомным аллокатором с кастомной кучей.
   using cust_vec_cust1_alloc_t = custom::allocator<int, 0>;
@@ -39,6 +45,7 @@ int main()
     int value = static_cast<int>(factorial(static_cast<uint32_t>(i)));
     map1[i] = value;
     map2[i] = value;
+    map3[i] = value;
     vec1.push_back(value);
     vec2.push_back(value);
     vec3.push_back(value);
@@ -58,6 +65,10 @@ int main()
   for(const auto& it: map2)
     std::cout << it.first << " " << it.second << std::endl;
 
+  std::cout << "Flat map with custom allocator" << std::endl;
+  for(const auto& it: map3)
+    std::cout << it.first << " " << it.second << std::endl;
+
   std::cout << "Custom vector with STL allocator" << std::endl;
   for(const auto& it: vec1)
     std::cout << it << std::endl;
@@ -0,0 +1,262 @@
+#include "../inc/shm_heap.h"
+#include "heap_region.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+namespace custom {
+
+///< Управляющий блок сегмента, за ним с границы страницы слэба начинается область кучи.
+struct shm_heap::control_t {
+  std::atomic<uint32_t> ready; // Признак завершенной инициализации сегмента.
+  pthread_mutex_t mutex;       // Мьютекс, разделяемый между процессами.
+};
+
+///< Смещение области кучи от начала сегмента.
+static constexpr size_t REGION_OFFSET = heap_region::SLAB_PAGE_SIZE;
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "Atomic flag in shared memory must be lock-free");
+
+/**
+ * @brief Выдать область кучи сегмента.
+ * @param control - управляющий блок сегмента.
+ * @param mappedSize - размер отображения.
+ */
+static heap_region regionOf(void* control, size_t mappedSize);
+
+/**
+ * @brief Ожидание выполнения условия, пока не истечет timeout.
+ * @param ready - проверяемое условие.
+ * @param timeout - время ожидания, мс.
+ * @return true, если условие выполнено.
+ */
+template <typename F>
+static bool waitFor(F ready, unsigned timeout);
+
+
+///< Куча, используемая shm_allocator.
+static shm_heap* currentHeap = nullptr;
+
+///< Список открытых куч процесса.
+static shm_heap* openHeaps = nullptr;
+
+///< Мьютекс списка открытых куч и текущей кучи.
+static std::mutex heapsMutex;
+
+
+shm_heap::shm_heap() : control_(nullptr), mappedSize_(0), next_(nullptr) {}
+
+shm_heap::~shm_heap() {
+  close();
+}
+
+bool shm_heap::open(const char* name, size_t size, unsigned timeout) {
+  close();
+
+  // Создатель сегмента определяется флагом O_EXCL, остальные процессы подключаются.
+  bool created = true;
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  if((fd < 0) && (errno == EEXIST)) {
+    created = false;
+    fd = shm_open(name, O_RDWR, 0600);
+  }
+  if(fd < 0)
+    return false;
+
+  if(created) {
+    size = (size + heap_region::SLAB_PAGE_SIZE - 1) / heap_region::SLAB_PAGE_SIZE * heap_region::SLAB_PAGE_SIZE;
+    mappedSize_ = REGION_OFFSET + size;
+    if((size == 0) || (ftruncate(fd, static_cast<off_t>(mappedSize_)) != 0)) {
+      ::close(fd);
+      shm_unlink(name);
+      return false;
+    }
+  }
+  else {
+    // Ожидание, пока создатель задаст размер сегмента.
+    struct stat st;
+    bool sized = waitFor([fd, &st]() {
+      return (fstat(fd, &st) != 0) || (st.st_size != 0);
+    }, timeout);
+    if(!sized || (st.st_size == 0)) {
+      ::close(fd);
+      return false;
+    }
+    mappedSize_ = static_cast<size_t>(st.st_size);
+  }
+
+  void* base = mmap(NULL, mappedSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if(base == MAP_FAILED) {
+    mappedSize_ = 0;
+    return false;
+  }
+  control_ = static_cast<control_t*>(base);
+
+  if(created) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&control_->mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    regionOf(control_, mappedSize_).format();
+    control_->ready.store(1, std::memory_order_release);
+  }
+  else {
+    // Создатель, завершившийся до конца разметки, не выставит признак готовности.
+    bool ready = waitFor([this]() {
+      return control_->ready.load(std::memory_order_acquire) != 0;
+    }, timeout);
+    if(!ready) {
+      munmap(control_, mappedSize_);
+      control_ = nullptr;
+      mappedSize_ = 0;
+      return false;
+    }
+  }
+
+  std::lock_guard<std::mutex> guard(heapsMutex);
+  next_ = openHeaps;
+  openHeaps = this;
+  if(currentHeap == nullptr)
+    currentHeap = this;
+  return true;
+}
+
+void shm_heap::close() {
+  if(control_ == nullptr)
+    return;
+
+  {
+    std::lock_guard<std::mutex> guard(heapsMutex);
+    shm_heap** it = &openHeaps;
+    while(*it != this)
+      it = &(*it)->next_;
+    *it = next_;
+    next_ = nullptr;
+
+    if(currentHeap == this)
+      currentHeap = nullptr;
+  }
+
+  munmap(control_, mappedSize_);
+  control_ = nullptr;
+  mappedSize_ = 0;
+}
+
+bool shm_heap::remove(const char* name) {
+  return shm_unlink(name) == 0;
+}
+
+void* shm_heap::malloc(size_t size) {
+  if(control_ == nullptr)
+    return NULL;
+
+  lock();
+  void* ptr = regionOf(control_, mappedSize_).malloc(size);
+  unlock();
+  return ptr;
+}
+
+void shm_heap::free(void* ptr) {
+  if(!contains(ptr))
+    return;
+
+  lock();
+  regionOf(control_, mappedSize_).free(ptr);
+  unlock();
+}
+
+size_t shm_heap::getFreeSize() {
+  if(control_ == nullptr)
+    return 0;
+
+  lock();
+  size_t size = regionOf(control_, mappedSize_).getFreeSize();
+  unlock();
+  return size;
+}
+
+void shm_heap::setRoot(void* ptr) {
+  if(control_ == nullptr)
+    return;
+
+  lock();
+  regionOf(control_, mappedSize_).setRoot(ptr);
+  unlock();
+}
+
+void* shm_heap::getRoot() {
+  if(control_ == nullptr)
+    return NULL;
+
+  lock();
+  void* root = regionOf(control_, mappedSize_).getRoot();
+  unlock();
+  return root;
+}
+
+bool shm_heap::contains(const void* ptr) const {
+  return (control_ != nullptr) && regionOf(control_, mappedSize_).contains(ptr);
+}
+
+void shm_heap::use() {
+  std::lock_guard<std::mutex> guard(heapsMutex);
+  currentHeap = this;
+}
+
+shm_heap* shm_heap::current() {
+  std::lock_guard<std::mutex> guard(heapsMutex);
+  return currentHeap;
+}
+
+shm_heap* shm_heap::owner(const void* ptr) {
+  if(ptr == NULL)
+    return nullptr;
+
+  std::lock_guard<std::mutex> guard(heapsMutex);
+  for(shm_heap* heap = openHeaps; heap != nullptr; heap = heap->next_) {
+    if(heap->contains(ptr))
+      return heap;
+  }
+  return nullptr;
+}
+
+void shm_heap::lock() {
+  // Если владелец мьютекса завершился аварийно, мьютекс восстанавливается,
+  // чтобы остальные процессы не остались заблокированными навсегда.
+  if(pthread_mutex_lock(&control_->mutex) == EOWNERDEAD)
+    pthread_mutex_consistent(&control_->mutex);
+}
+
+void shm_heap::unlock() {
+  pthread_mutex_unlock(&control_->mutex);
+}
+
+static heap_region regionOf(void* control, size_t mappedSize) {
+  return heap_region(static_cast<uint8_t*>(control) + REGION_OFFSET, mappedSize - REGION_OFFSET);
+}
+
+template <typename F>
+static bool waitFor(F ready, unsigned timeout) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+  while(!ready()) {
+    if(std::chrono::steady_clock::now() >= deadline)
+      return false;
+    sched_yield();
+  }
+  return true;
+}
+
+}
@@ -0,0 +1,146 @@
+#include "../inc/vector_io.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <string>
+
+namespace custom {
+namespace detail {
+
+///< Заголовок файла вектора, данные элементов начинаются с PAYLOAD_OFFSET.
+struct vector_file_header_t {
+  char magic[8];         // Сигнатура файла.
+  uint32_t version;      // Версия формата.
+  uint32_t byteOrder;    // Маркер порядка байт записавшей платформы.
+  uint32_t elementSize;  // Размер элемента.
+  uint32_t elementAlign; // Выравнивание элемента.
+  uint64_t count;        // Количество элементов.
+};
+
+///< Сигнатура файла вектора.
+static constexpr char VECTOR_FILE_MAGIC[8] = {'C', 'U', 'S', 'T', 'V', 'E', 'C', '\0'};
+
+///< Версия формата файла вектора.
+static constexpr uint32_t VECTOR_FILE_VERSION = 1;
+
+///< Маркер порядка байт.
+static constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+///< Смещение данных элементов (выравнивание данных в отображении).
+static constexpr size_t PAYLOAD_OFFSET = 64;
+
+static_assert(sizeof(vector_file_header_t) <= PAYLOAD_OFFSET, "Vector file header must fit before payload");
+
+
+bool writeVectorFile(const char* path, size_t elementSize, size_t elementAlign, const void* data, size_t count) {
+  if(elementAlign > PAYLOAD_OFFSET)
+    return false;
+
+  uint8_t header[PAYLOAD_OFFSET] = {};
+  vector_file_header_t fields;
+  memcpy(fields.magic, VECTOR_FILE_MAGIC, sizeof(fields.magic));
+  fields.version = VECTOR_FILE_VERSION;
+  fields.byteOrder = BYTE_ORDER_MARK;
+  fields.elementSize = static_cast<uint32_t>(elementSize);
+  fields.elementAlign = static_cast<uint32_t>(elementAlign);
+  fields.count = count;
+  memcpy(header, &fields, sizeof(fields));
+
+  // Запись идет во временный файл: отображения path другими vector_view не затрагиваются.
+  std::string tmpPath = std::string(path) + ".tmp";
+  int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(fd < 0)
+    return false;
+
+  // Заголовок и данные уходят одним системным вызовом, повтор - только при частичной записи.
+  iovec parts[2] = {
+    {header, sizeof(header)},
+    {const_cast<void*>(data), elementSize * count}
+  };
+  iovec* part = parts;
+  int partCount = count > 0 ? 2 : 1;
+  while(partCount > 0) {
+    ssize_t written = writev(fd, part, partCount);
+    if((written < 0) && (errno == EINTR))
+      continue;
+    if(written <= 0) {
+      ::close(fd);
+      unlink(tmpPath.c_str());
+      return false;
+    }
+
+    size_t rest = static_cast<size_t>(written);
+    while((partCount > 0) && (rest >= part->iov_len)) {
+      rest -= part->iov_len;
+      ++part;
+      --partCount;
+    }
+    if(partCount > 0) {
+      part->iov_base = static_cast<uint8_t*>(part->iov_base) + rest;
+      part->iov_len -= rest;
+    }
+  }
+
+  // Файл заменяется только полностью записанным на диск.
+  bool synced = fsync(fd) == 0;
+  bool closed = ::close(fd) == 0;
+  if(!synced || !closed || (rename(tmpPath.c_str(), path) != 0)) {
+    unlink(tmpPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+const uint8_t* mapVectorFile(const char* path, size_t elementSize, size_t elementAlign,
+                             size_t& count, size_t& mappedSize) {
+  int fd = ::open(path, O_RDONLY);
+  if(fd < 0)
+    return nullptr;
+
+  struct stat st;
+  if((fstat(fd, &st) != 0) || (static_cast<size_t>(st.st_size) < PAYLOAD_OFFSET)) {
+    ::close(fd);
+    return nullptr;
+  }
+
+  size_t size = static_cast<size_t>(st.st_size);
+  void* base = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if(base == MAP_FAILED)
+    return nullptr;
+
+  // Файл должен быть записан для элементов того же размера и выравнивания на платформе с тем же порядком байт.
+  vector_file_header_t header;
+  memcpy(&header, base, sizeof(header));
+  bool valid = (memcmp(header.magic, VECTOR_FILE_MAGIC, sizeof(header.magic)) == 0) &&
+               (header.version == VECTOR_FILE_VERSION) &&
+               (header.byteOrder == BYTE_ORDER_MARK) &&
+               (header.elementSize == elementSize) &&
+               (header.elementAlign == elementAlign) &&
+               (header.count <= (size - PAYLOAD_OFFSET) / elementSize);
+  if(!valid) {
+    munmap(base, size);
+    return nullptr;
+  }
+
+  count = static_cast<size_t>(header.count);
+  mappedSize = size;
+  return static_cast<const uint8_t*>(base);
+}
+
+size_t vectorFilePayloadOffset() {
+  return PAYLOAD_OFFSET;
+}
+
+void unmapVectorFile(const uint8_t* base, size_t mappedSize) {
+  munmap(const_cast<uint8_t*>(base), mappedSize);
+}
+
+}
+}
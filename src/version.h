@@ -0,0 +1,5 @@
+#pragma once
+
+#define PROJECT_VERSION_MAJOR 1
+#define PROJECT_VERSION_MINOR 1
+#define PROJECT_VERSION_PATCH 1
@@ -1,13 +1,31 @@
 #include "gtest/gtest.h"
+#include "../inc/concurrent_vector.h"
 #include "../inc/custom_allocator.h"
 #include "../inc/custom_vector.h"
 #include "../inc/factorial.h"
+#include "../inc/flat_map.h"
+#include "../inc/frame_pool.h"
+#include "../inc/handle_heap.h"
+#include "../inc/hash_map.h"
+#include "../inc/heap_profiler.h"
+#include "../inc/segmented_vector.h"
+#include "../inc/shm_heap.h"
+#include "../inc/vector_io.h"
 #include "../inc/ver.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <cstdio>
 #include <map>
 #include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 TEST(ver_test_case, ver_major_test) {
   EXPECT_GE(ver_major(), 1);
@@ -153,6 +171,12 @@ TEST(allocator_test_case, allocate_cust_heap_test)
   EXPECT_NE(ptr, nullptr);
 }
 
+TEST(allocator_test_case, allocate_cust_heap_fail_test) {
+  custom::allocator<int, 0> allocator;
+  EXPECT_THROW(allocator.allocate(custom::HEAP_SIZE), std::bad_alloc);
+  EXPECT_EQ(allocator.try_allocate(custom::HEAP_SIZE), nullptr);
+}
+
 TEST(allocator_test_case, deallocate_cust_heap_test) {
   constexpr size_t N = 10;
   custom::allocator<int, 0> allocator;
@@ -167,6 +191,189 @@ TEST(allocator_test_case, deallocate_cust_heap_test) {
   }
 }
 
+TEST(allocator_test_case, cust_heap_small_blocks_test) {
+  constexpr size_t N = 100;
+  custom::allocator<int, 0> allocator;
+  std::array<int*, N> ptrs;
+
+  // Первое выделение инициализирует кучу и страницу класса, которая остается в кэше.
+  allocator.deallocate(allocator.allocate(1), 1);
+  auto freeSize = custom::getFreeHeapSize();
+
+  // Малые блоки размещаются без заголовка, подряд в странице слэба.
+  for(size_t i = 0; i < N; ++i) {
+    ptrs[i] = allocator.allocate(1);
+    ASSERT_NE(ptrs[i], nullptr);
+    *ptrs[i] = static_cast<int>(i);
+  }
+  EXPECT_EQ(reinterpret_cast<uint8_t*>(ptrs[1]) - reinterpret_cast<uint8_t*>(ptrs[0]), 8);
+
+  for(size_t i = 0; i < N; ++i)
+    EXPECT_EQ(*ptrs[i], static_cast<int>(i));
+
+  for(size_t i = 0; i < N; i += 2)
+    allocator.deallocate(ptrs[i], 1);
+  for(size_t i = 1; i < N; i += 2)
+    custom::free(ptrs[i]);
+
+  EXPECT_EQ(custom::getFreeHeapSize(), freeSize);
+}
+
+TEST(allocator_test_case, bulk_test) {
+  constexpr size_t N = 10;
+  custom::allocator<int, N> allocator;
+  std::array<int*, N> ptrs;
+
+  try {
+    allocator.allocate_bulk(1, N, ptrs.data());
+    for(size_t i = 1; i < N; ++i)
+      EXPECT_EQ(ptrs[i] - ptrs[i - 1], 1);
+    allocator.deallocate_bulk(ptrs.data(), N, 1);
+    allocator.allocate_bulk(2, N / 2, ptrs.data());
+
+    // Несмежные блоки освобождаются по отдельности, пустые указатели пропускаются.
+    std::array<int*, N / 2> some{{ptrs[0], nullptr, ptrs[2], ptrs[3], nullptr}};
+    allocator.deallocate_bulk(some.data(), some.size(), 2);
+    allocator.allocate_bulk(2, 3, ptrs.data());
+  }
+  catch (const std::bad_alloc &e) {
+    FAIL() << e.what();
+  }
+
+  bool is_bad_alloc{false};
+  try {
+    allocator.allocate_bulk(1, 1, ptrs.data());
+  }
+  catch (const std::bad_alloc &e) {
+    is_bad_alloc = true;
+  }
+  EXPECT_TRUE(is_bad_alloc);
+}
+
+TEST(allocator_test_case, cust_heap_bulk_test) {
+  constexpr size_t N = 200;
+  custom::allocator<int, 0> small;
+  custom::allocator<std::array<int, 64>, 0> large;
+  std::array<int*, N> smallPtrs;
+  std::array<std::array<int, 64>*, N / 10> largePtrs;
+
+  small.deallocate(small.allocate(1), 1);
+  auto freeSize = custom::getFreeHeapSize();
+
+  try {
+    small.allocate_bulk(1, N, smallPtrs.data());
+    large.allocate_bulk(1, largePtrs.size(), largePtrs.data());
+  }
+  catch (const std::bad_alloc &e) {
+    FAIL() << e.what();
+  }
+
+  for(size_t i = 0; i < N; ++i)
+    *smallPtrs[i] = static_cast<int>(i);
+  for(auto ptr: largePtrs)
+    ptr->fill(-1);
+  for(size_t i = 0; i < N; ++i)
+    EXPECT_EQ(*smallPtrs[i], static_cast<int>(i));
+
+  // Освобождение не меняет массив указателей вызывающего.
+  auto largeCopy = largePtrs;
+  small.deallocate_bulk(smallPtrs.data(), N, 1);
+  large.deallocate_bulk(largePtrs.data(), largePtrs.size(), 1);
+  EXPECT_EQ(largePtrs, largeCopy);
+
+  EXPECT_EQ(custom::getFreeHeapSize(), freeSize);
+}
+
+TEST(allocator_test_case, cust_heap_batch_test) {
+  constexpr size_t N = 16;
+  std::array<void*, N> ptrs;
+  custom::free(custom::malloc(128));
+  auto freeSize = custom::getFreeHeapSize();
+
+  // Файл кучи не открыт: весь пакет относится к куче процесса, пустые элементы пропускаются.
+  ASSERT_EQ(custom::malloc_batch(128, N, ptrs.data()), N);
+  custom::free(ptrs[5]);
+  ptrs[5] = nullptr;
+  custom::free_batch(ptrs.data(), N);
+  custom::free_batch(ptrs.data(), 0);
+  EXPECT_EQ(custom::getFreeHeapSize(), freeSize);
+}
+
+TEST(allocator_test_case, cust_heap_threads_test) {
+  constexpr int THREADS = 4;
+  constexpr int ROUNDS = 2000;
+  custom::allocator<int, 0> alloc;
+  alloc.deallocate(alloc.allocate(1), 1);
+  auto freeSize = custom::getFreeHeapSize();
+  std::vector<std::thread> threads;
+
+  for(int t = 0; t < THREADS; ++t)
+    threads.emplace_back([t]() {
+      custom::allocator<int, 0> alloc;
+      for(int i = 0; i < ROUNDS; ++i) {
+        int* ptr = alloc.allocate(32 + i % 16);
+        *ptr = t;
+        EXPECT_EQ(*ptr, t);
+        alloc.deallocate(ptr, 32 + i % 16);
+      }
+    });
+  for(auto& thread: threads)
+    thread.join();
+
+  EXPECT_EQ(custom::getFreeHeapSize(), freeSize);
+}
+
+TEST(allocator_test_case, fallback_test) {
+  constexpr size_t N = 4;
+  using alloc_t = custom::fallback<custom::allocator<int, N>, std::allocator<int>>;
+  alloc_t allocator;
+  int* ptr1{nullptr};
+  int* ptr2{nullptr};
+
+  try {
+    ptr1 = allocator.allocate(N);
+    ptr2 = allocator.allocate(N);
+  }
+  catch (const std::bad_alloc &e) {
+    FAIL() << e.what();
+  }
+
+  EXPECT_TRUE(allocator.owns(ptr1));
+  EXPECT_FALSE(allocator.owns(ptr2));
+  allocator.deallocate(ptr2, N);
+  allocator.deallocate(ptr1, N);
+
+  // Вектор растет за пределы пула без предварительного reserve().
+  custom::vector<int, alloc_t> vec;
+  for(int i = 0; i < 100; ++i)
+    vec.push_back(i);
+  EXPECT_EQ(vec[99], 99);
+}
+
+TEST(allocator_test_case, segregator_test) {
+  using small_t = custom::allocator<std::pair<const int, int>, 8>;
+  using large_t = custom::allocator<std::pair<const int, int>, 0>;
+  // Малые узлы берутся из пула, а при его исчерпании - из кучи, как и большие запросы.
+  using alloc_t = custom::segregator<64, custom::fallback<small_t, large_t>, large_t>;
+  std::map<int, int, std::less<int>, alloc_t> map;
+
+  try {
+    for(int i = 0; i < 100; ++i)
+      map[i] = i * i;
+  }
+  catch (const std::bad_alloc &e) {
+    FAIL() << e.what();
+  }
+
+  EXPECT_EQ(map.size(), 100);
+  EXPECT_EQ(map[9], 81);
+
+  alloc_t allocator;
+  auto ptr = allocator.allocate(16);
+  EXPECT_NE(ptr, nullptr);
+  allocator.deallocate(ptr, 16);
+}
+
 TEST(vector_test_case, reserve_test) {
   constexpr size_t N = 20;
   custom::vector<int> vec1;
@@ -234,6 +441,1006 @@ TEST(vector_test_case, range_for_test) {
   EXPECT_EQ(ss.str(), "1234");
 }
 
+TEST(profiler_test_case, sampled_profile_test) {
+  // Учет вызывается из try_allocate (noexcept) и не должен выбрасывать исключений.
+  static_assert(noexcept(custom::profiler::recordAlloc(nullptr, 0)), "Profiler hooks must not throw");
+  static_assert(noexcept(custom::profiler::recordFree(nullptr)), "Profiler hooks must not throw");
+
+  custom::allocator<std::array<int, 32>, 0> allocator;
+  custom::profiler::reset();
+  custom::profiler::setSampleRate(1);
+
+  auto ptr = allocator.allocate(1);
+  std::stringstream live;
+  custom::profiler::dumpHeapProfile(live);
+  EXPECT_EQ(live.str().find("heap profile: 1: 128 [1: 128] @ heap_v2/1"), 0);
+
+  allocator.deallocate(ptr, 1);
+  std::stringstream folded;
+  custom::profiler::dumpFoldedStacks(folded, true);
+  EXPECT_TRUE(folded.str().empty());
+  custom::profiler::dumpFoldedStacks(folded, false);
+  EXPECT_NE(folded.str().find(" 128\n"), std::string::npos);
+
+  custom::profiler::setSampleRate(0);
+  custom::profiler::reset();
+}
+
+namespace {
+/**
+ * @brief Выделение блока из пула и из кучи в одной функции: стеки обоих семплов начинаются в ней.
+ */
+__attribute__((noinline)) void allocateProfiled(custom::allocator<int, 64>& pool, int*& poolPtr, void*& heapPtr) {
+  poolPtr = pool.allocate(4);
+  heapPtr = custom::malloc(64);
+}
+}
+
+TEST(profiler_test_case, stack_depth_test) {
+#if defined(__SANITIZE_THREAD__) || defined(__SANITIZE_ADDRESS__)
+  GTEST_SKIP() << "Sanitizer interceptors add frames to backtrace()";
+#endif
+  custom::allocator<int, 64> pool;
+  int* poolPtr;
+  void* heapPtr;
+  custom::profiler::reset();
+  custom::profiler::setSampleRate(1);
+  allocateProfiled(pool, poolPtr, heapPtr);
+  custom::profiler::setSampleRate(0);
+
+  std::stringstream profile;
+  custom::profiler::dumpHeapProfile(profile);
+  auto begin = reinterpret_cast<uintptr_t>(&allocateProfiled);
+  int stacks = 0;
+  std::string line;
+  while(std::getline(profile, line) && !line.empty()) {
+    auto at = line.find(" @ 0x");
+    if(at == std::string::npos)
+      continue;
+
+    // Верхний кадр стека - адрес возврата внутри allocateProfiled, а не в аллокаторе.
+    uintptr_t top = std::stoull(line.substr(at + 3), nullptr, 16);
+    EXPECT_GT(top, begin);
+    EXPECT_LT(top, begin + 256);
+    ++stacks;
+  }
+  EXPECT_EQ(stacks, 2);
+
+  pool.deallocate(poolPtr, 4);
+  custom::free(heapPtr);
+  custom::profiler::reset();
+}
+
+TEST(profiler_test_case, threads_test) {
+  constexpr int THREADS = 4;
+  std::atomic<bool> done(false);
+  custom::profiler::reset();
+  custom::profiler::setSampleRate(64);
+
+  std::vector<std::thread> threads;
+  for(int t = 0; t < THREADS; ++t)
+    threads.emplace_back([]() {
+      custom::allocator<int, 256> pool;
+      for(int i = 0; i < 2000; ++i)
+        pool.deallocate(pool.allocate(1 + i % 8), 1 + i % 8);
+    });
+  std::thread dumper([&done]() {
+    while(!done) {
+      std::stringstream os;
+      custom::profiler::dumpHeapProfile(os);
+    }
+  });
+  for(auto& thread: threads)
+    thread.join();
+  done = true;
+  dumper.join();
+
+  custom::profiler::setSampleRate(0);
+  std::stringstream folded;
+  custom::profiler::dumpFoldedStacks(folded, true);
+  EXPECT_TRUE(folded.str().empty());
+  custom::profiler::reset();
+}
+
+TEST(vector_test_case, random_access_iterator_test) {
+  custom::vector<int> vec{5, 3, 1, 4, 2};
+  std::sort(vec.begin(), vec.end());
+
+  const auto& cvec = vec;
+  EXPECT_EQ(cvec.end() - cvec.begin(), 5);
+  EXPECT_EQ(*std::lower_bound(cvec.begin(), cvec.end(), 3), 3);
+  EXPECT_EQ(cvec.begin()[4], 5);
+  EXPECT_EQ(vec.data(), &vec[0]);
+
+  custom::vector<int>::const_iterator it = vec.begin();
+  EXPECT_TRUE(it == vec.cbegin());
+  EXPECT_TRUE(it + 5 == vec.cend());
+}
+
+TEST(vector_test_case, at_test) {
+  custom::vector<int> vec{1, 2, 3};
+  bool is_out_of_range{false};
+
+  EXPECT_EQ(vec.at(2), 3);
+  try {
+    vec.at(3);
+  }
+  catch (const std::out_of_range &e) {
+    is_out_of_range = true;
+  }
+
+  EXPECT_TRUE(is_out_of_range);
+}
+
+TEST(vector_test_case, growth_factor_test) {
+  custom::vector<int, std::allocator<int>, std::ratio<3, 2>> vec;
+  std::stringstream ss;
+
+  for(int i = 0; i < 10; ++i) {
+    vec.push_back(i);
+    ss << vec.capacity() << " ";
+  }
+
+  EXPECT_EQ(ss.str(), "2 2 3 4 6 6 9 9 9 13 ");
+}
+
+TEST(vector_test_case, allocator_aware_capacity_test) {
+  custom::vector<char, custom::allocator<char, 0>> vec1;
+  vec1.push_back('a');
+  EXPECT_EQ(vec1.capacity(), 8);
+
+  // Без reserve вектор заполняет пул целиком: блок расширяется на месте, а емкость ограничена пулом.
+  constexpr size_t N = 10;
+  custom::vector<int, custom::allocator<int, N>> vec2;
+  try {
+    for(size_t i = 0; i < N; ++i)
+      vec2.push_back(static_cast<int>(i));
+  }
+  catch (const std::bad_alloc &e) {
+    FAIL() << e.what();
+  }
+  EXPECT_EQ(vec2.size(), N);
+  EXPECT_EQ(vec2.capacity(), N);
+  for(size_t i = 0; i < N; ++i)
+    EXPECT_EQ(vec2[i], static_cast<int>(i));
+  EXPECT_THROW(vec2.push_back(0), std::length_error);
+}
+
+TEST(vector_test_case, shrink_to_fit_test) {
+  custom::vector<int> vec;
+  vec.reserve(16);
+  vec.push_back(1);
+  vec.push_back(2);
+
+  vec.shrink_to_fit();
+  EXPECT_EQ(vec.capacity(), 2);
+  EXPECT_EQ(vec[1], 2);
+
+  vec.clear();
+  vec.shrink_to_fit();
+  EXPECT_EQ(vec.capacity(), 0);
+}
+
+TEST(vector_test_case, resize_test) {
+  custom::vector<int> vec{1, 2};
+  vec.resize(4);
+  EXPECT_EQ(vec.size(), 4);
+  EXPECT_EQ(vec[3], 0);
+
+  vec.resize(1);
+  EXPECT_EQ(vec.size(), 1);
+}
+
+TEST(flat_map_test_case, insert_find_test) {
+  custom::flat_map<int, int> map;
+  for(int i = 9; i >= 0; --i)
+    EXPECT_TRUE(map.insert(std::make_pair(i * 2, i)).second);
+  EXPECT_FALSE(map.insert(std::make_pair(4, 100)).second);
+
+  EXPECT_EQ(map.size(), 10);
+  EXPECT_TRUE(std::is_sorted(map.keys().begin(), map.keys().end()));
+  EXPECT_EQ(map.at(4), 2);
+  EXPECT_EQ(map.find(5), map.end());
+  EXPECT_EQ(map.lower_bound(5)->first, 6);
+  EXPECT_EQ(map.lower_bound(100), map.end());
+  EXPECT_THROW(map.at(7), std::out_of_range);
+
+  map[7] = 70;
+  EXPECT_EQ(map.find(7)->second, 70);
+  EXPECT_EQ(map.erase(7), 1);
+  EXPECT_EQ(map.erase(7), 0);
+  map.erase(map.begin());
+  EXPECT_EQ(map.begin()->first, 2);
+  EXPECT_EQ(map.size(), 9);
+}
+
+TEST(flat_map_test_case, bulk_insert_test) {
+  std::map<int, int> expected;
+  std::array<std::pair<int, int>, 6> unsorted{{{5, 1}, {1, 1}, {3, 1}, {1, 2}, {9, 1}, {3, 2}}};
+  custom::flat_map<int, int> map{{3, 0}, {7, 0}};
+  expected.insert({{3, 0}, {7, 0}});
+
+  map.insert(unsorted.begin(), unsorted.end());
+  expected.insert(unsorted.begin(), unsorted.end());
+
+  std::array<std::pair<int, int>, 3> sorted{{{0, 5}, {8, 5}, {10, 5}}};
+  map.insert(custom::sorted_unique, sorted.begin(), sorted.end());
+  expected.insert(sorted.begin(), sorted.end());
+
+  EXPECT_EQ(map.size(), expected.size());
+  EXPECT_TRUE(std::equal(map.begin(), map.end(), expected.begin(),
+    [](std::pair<const int&, const int&> lhs, const std::pair<const int, int>& rhs) {
+      return lhs.first == rhs.first && lhs.second == rhs.second;
+    }));
+}
+
+TEST(flat_map_test_case, custom_allocator_test) {
+  using alloc_t = custom::allocator<std::pair<const int, int>, 0>;
+  custom::flat_map<int, int, std::greater<int>, alloc_t> map;
+  map.reserve(100);
+  for(int i = 0; i < 100; ++i)
+    map[i] = i * i;
+
+  EXPECT_EQ(map.size(), 100);
+  EXPECT_EQ(map.begin()->first, 99);
+  for(int i = 0; i < 100; ++i)
+    EXPECT_EQ(map.at(i), i * i);
+
+  // Временные массивы слияния выделяются тем же (перепривязанным) аллокатором.
+  std::array<std::pair<int, int>, 4> more{{{150, 1}, {-5, 1}, {120, 1}, {7, 1}}};
+  map.insert(more.begin(), more.end());
+  EXPECT_EQ(map.size(), 103);
+  EXPECT_EQ(map.begin()->first, 150);
+  EXPECT_EQ(map.at(7), 49);
+}
+
+///< Количество копирований throwing_value до исключения.
+static int copiesLeft = 0;
+
+///< Значение, копирование которого выбрасывает исключение, когда copiesLeft исчерпан.
+struct throwing_value {
+  int value;
+
+  throwing_value(int value = 0) : value(value) {}
+
+  throwing_value(const throwing_value& other) : value(other.value) {
+    if(--copiesLeft < 0)
+      throw std::runtime_error("Copy failed");
+  }
+
+  throwing_value& operator = (const throwing_value&) = default;
+};
+
+TEST(flat_map_test_case, insert_rollback_test) {
+  custom::flat_map<int, throwing_value> map;
+  map.reserve(8);
+  copiesLeft = 1000;
+  map.insert(std::make_pair(1, throwing_value(1)));
+  map.insert(std::make_pair(3, throwing_value(3)));
+
+  // Неудачная вставка значения не оставляет ключ без значения.
+  auto value = std::make_pair(2, throwing_value(2));
+  copiesLeft = 0;
+  EXPECT_THROW(map.insert(value), std::runtime_error);
+  EXPECT_EQ(map.size(), 2);
+  EXPECT_THROW(map.at(2), std::out_of_range);
+  EXPECT_EQ(map.at(3).value, 3);
+
+  // Неудачная вставка диапазона не оставляет дописанных элементов.
+  copiesLeft = 1000;
+  std::vector<std::pair<int, throwing_value>> range{{0, 0}, {4, 4}};
+  copiesLeft = 1;
+  EXPECT_THROW(map.insert(range.begin(), range.end()), std::runtime_error);
+  EXPECT_EQ(map.size(), 2);
+  EXPECT_EQ(map.at(1).value, 1);
+  EXPECT_EQ(map.at(3).value, 3);
+  copiesLeft = 0;
+}
+
+TEST(hash_map_test_case, insert_find_erase_test) {
+  custom::hash_map<int, int> map;
+  std::map<int, int> expected;
+
+  // Вставки и удаления вперемешку, чтобы таблица проходила через перестроения и отметки удаленных.
+  for(int i = 0; i < 5000; ++i) {
+    int key = (i * 7919) % 1000;
+    if(i % 3 == 2) {
+      EXPECT_EQ(map.erase(key), expected.erase(key));
+    }
+    else {
+      auto res = map.insert(std::make_pair(key, i));
+      EXPECT_EQ(res.second, expected.insert(std::make_pair(key, i)).second);
+      EXPECT_EQ(res.first->first, key);
+    }
+  }
+
+  EXPECT_EQ(map.size(), expected.size());
+  for(const auto& it: expected)
+    EXPECT_EQ(map.at(it.first), it.second);
+
+  size_t count = 0;
+  for(const auto& it: map) {
+    EXPECT_EQ(expected[it.first], it.second);
+    ++count;
+  }
+  EXPECT_EQ(count, expected.size());
+  EXPECT_FALSE(map.contains(1000));
+  EXPECT_THROW(map.at(1000), std::out_of_range);
+}
+
+TEST(hash_map_test_case, reserve_test) {
+  custom::hash_map<int, std::string, std::hash<int>, custom::allocator<std::pair<const int, std::string>, 0>> map;
+  map.reserve(100);
+  auto capacity = map.capacity();
+  EXPECT_GE(capacity * map.max_load_factor(), 100);
+
+  for(int i = 0; i < 100; ++i)
+    map[i] = std::to_string(i);
+  EXPECT_EQ(map.capacity(), capacity);
+
+  auto copy = map;
+  map.clear();
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(copy.size(), 100);
+  EXPECT_EQ(copy[42], "42");
+
+  copy.rehash(0);
+  EXPECT_EQ(copy.capacity(), capacity);
+  EXPECT_EQ(copy.find(99)->second, "99");
+}
+
+TEST(handle_heap_test_case, compact_test) {
+  constexpr size_t BLOCKS = 16;
+  constexpr size_t BLOCK_SIZE = 112;
+  alignas(16) static uint8_t memory[BLOCKS * (BLOCK_SIZE + 16)];
+  custom::handle_heap heap(memory, sizeof(memory));
+  std::array<custom::handle_heap::handle, BLOCKS> handles;
+
+  for(size_t i = 0; i < BLOCKS; ++i) {
+    handles[i] = heap.allocate(BLOCK_SIZE);
+    ASSERT_NE(handles[i], custom::handle_heap::INVALID_HANDLE);
+    custom::pinned<uint8_t> ptr(heap, handles[i]);
+    std::fill(ptr.get(), ptr.get() + BLOCK_SIZE, static_cast<uint8_t>(i));
+  }
+  EXPECT_EQ(heap.allocate(1), custom::handle_heap::INVALID_HANDLE);
+
+  // Освобождение каждого второго блока: свободна половина кучи, но участками по одному блоку.
+  for(size_t i = 0; i < BLOCKS; i += 2)
+    heap.release(handles[i]);
+  EXPECT_EQ(heap.getFreeSize(), sizeof(memory) / 2);
+  EXPECT_EQ(heap.getLargestFreeBlock(), BLOCK_SIZE);
+
+  // Закрепленный блок не перемещается при уплотнении.
+  void* pinnedAddress = heap.pin(handles[BLOCKS - 1]);
+  heap.compact();
+  EXPECT_EQ(heap.pin(handles[BLOCKS - 1]), pinnedAddress);
+  heap.unpin(handles[BLOCKS - 1]);
+  heap.unpin(handles[BLOCKS - 1]);
+  EXPECT_EQ(heap.getLargestFreeBlock(), (BLOCKS / 2) * (BLOCK_SIZE + 16) - 16);
+
+  for(size_t i = 1; i < BLOCKS; i += 2) {
+    custom::pinned<uint8_t> ptr(heap, handles[i]);
+    EXPECT_EQ(ptr[0], i);
+    EXPECT_EQ(ptr[BLOCK_SIZE - 1], i);
+  }
+
+  // Большой блок выделяется после автоматического уплотнения.
+  heap.release(handles[1]);
+  auto big = heap.allocate((BLOCKS / 2 + 1) * (BLOCK_SIZE + 16) - 16);
+  EXPECT_NE(big, custom::handle_heap::INVALID_HANDLE);
+  EXPECT_EQ(heap.getFreeSize(), 0);
+  heap.release(big);
+  EXPECT_EQ(heap.pin(big), nullptr);
+}
+
+TEST(handle_heap_test_case, stale_handle_test) {
+  alignas(16) static uint8_t memory[1024];
+  custom::handle_heap heap(memory, sizeof(memory));
+
+  auto first = heap.allocate(32);
+  ASSERT_NE(first, custom::handle_heap::INVALID_HANDLE);
+  {
+    // Закрепленный блок не освобождается, пока его адрес используется.
+    custom::pinned<int> ptr(heap, first);
+    EXPECT_FALSE(heap.release(first));
+    *ptr = 1;
+  }
+  EXPECT_TRUE(heap.release(first));
+  EXPECT_FALSE(heap.release(first));
+
+  // Новый блок занимает ту же запись таблицы, но старый дескриптор на него не указывает.
+  auto second = heap.allocate(32);
+  ASSERT_NE(second, custom::handle_heap::INVALID_HANDLE);
+  EXPECT_NE(second, first);
+  EXPECT_EQ(heap.pin(first), nullptr);
+  EXPECT_EQ(heap.getUsableSize(first), 0);
+  EXPECT_FALSE(heap.release(first));
+
+  EXPECT_NE(heap.pin(second), nullptr);
+  heap.unpin(second);
+  EXPECT_TRUE(heap.release(second));
+}
+
+TEST(concurrent_vector_test_case, concurrent_push_back_test) {
+  constexpr int THREADS = 8;
+  constexpr int ELEMS = 10000;
+  custom::concurrent_vector<int> vec;
+  std::vector<std::thread> threads;
+
+  for(int t = 0; t < THREADS; ++t)
+    threads.emplace_back([&vec, t]() {
+      for(int i = 0; i < ELEMS; ++i) {
+        if(i % 100 == 0)
+          std::fill_n(vec.grow_by(10), 10, -1);
+        vec.push_back(t * ELEMS + i);
+      }
+    });
+  for(auto& thread: threads)
+    thread.join();
+
+  ASSERT_EQ(vec.size(), THREADS * ELEMS + THREADS * ELEMS / 10);
+  std::vector<int> values(vec.begin(), vec.end());
+  std::sort(values.begin(), values.end());
+  auto first = std::upper_bound(values.begin(), values.end(), -1);
+  EXPECT_EQ(first - values.begin(), THREADS * ELEMS / 10);
+  for(int i = 0; i < THREADS * ELEMS; ++i)
+    ASSERT_EQ(first[i], i);
+}
+
+TEST(concurrent_vector_test_case, stable_address_test) {
+  custom::concurrent_vector<int, custom::allocator<int, 0>> vec;
+  vec.reserve(20);
+  EXPECT_GE(vec.capacity(), 20);
+
+  vec.push_back(42);
+  const int* first = &vec[0];
+  auto it = vec.grow_by(1000, 7);
+  EXPECT_EQ(it - vec.begin(), 1);
+  EXPECT_EQ(&vec[0], first);
+  EXPECT_EQ(vec.at(0), 42);
+  EXPECT_EQ(vec.at(1000), 7);
+  EXPECT_THROW(vec.at(1001), std::out_of_range);
+
+  vec.clear();
+  EXPECT_TRUE(vec.empty());
+  EXPECT_EQ(vec.capacity(), 0);
+}
+
+///< Количество существующих экземпляров counted_value.
+static int liveValues = 0;
+
+///< Значение с учетом существующих экземпляров, копирование выбрасывает исключение как у throwing_value.
+struct counted_value : throwing_value {
+  counted_value(int value = 0) : throwing_value(value) {
+    ++liveValues;
+  }
+
+  counted_value(const counted_value& other) : throwing_value(other) {
+    ++liveValues;
+  }
+
+  ~counted_value() {
+    --liveValues;
+  }
+};
+
+TEST(concurrent_vector_test_case, construct_failure_test) {
+  {
+    custom::concurrent_vector<counted_value> vec;
+    counted_value value(1);
+    copiesLeft = 1000;
+    vec.push_back(value);
+    vec.grow_by(3, value);
+    EXPECT_EQ(liveValues, 5);
+
+    // Созданные элементы неудачного диапазона удаляются, индексы возвращаются.
+    copiesLeft = 2;
+    EXPECT_THROW(vec.grow_by(4, value), std::runtime_error);
+    EXPECT_EQ(liveValues, 5);
+    EXPECT_EQ(vec.size(), 4);
+    copiesLeft = 0;
+    EXPECT_THROW(vec.push_back(value), std::runtime_error);
+    EXPECT_EQ(vec.size(), 4);
+
+    copiesLeft = 1000;
+    auto it = vec.push_back(value);
+    EXPECT_EQ(it - vec.begin(), 4);
+    EXPECT_EQ(vec.size(), 5);
+    EXPECT_EQ(liveValues, 6);
+
+    vec.clear();
+    EXPECT_EQ(liveValues, 1);
+    vec.push_back(value);
+  }
+  EXPECT_EQ(liveValues, 0);
+}
+
+struct reentrant_value;
+
+///< Вектор, в который reentrant_value добавляет элемент при неудачном копировании.
+static custom::concurrent_vector<reentrant_value>* reentrantTarget = nullptr;
+
+///< Значение, копирование которого при отрицательном value добавляет -value в reentrantTarget и выбрасывает исключение.
+struct reentrant_value {
+  int value;
+
+  reentrant_value(int value) : value(value) {}
+
+  reentrant_value(const reentrant_value& other) : value(other.value) {
+    if(value < 0) {
+      reentrantTarget->push_back(reentrant_value(-value));
+      throw std::runtime_error("Copy failed");
+    }
+  }
+};
+
+TEST(concurrent_vector_test_case, broken_slot_test) {
+  custom::concurrent_vector<reentrant_value> vec;
+  reentrantTarget = &vec;
+
+  // Пока создается элемент 0, индекс 1 уже выдан: ячейка 0 помечается удаленной.
+  EXPECT_THROW(vec.push_back(reentrant_value(-1)), std::runtime_error);
+  vec.push_back(reentrant_value(2));
+  EXPECT_THROW(vec.push_back(reentrant_value(-3)), std::runtime_error);
+  vec.push_back(reentrant_value(4));
+
+  EXPECT_EQ(vec.size(), 6);
+  EXPECT_THROW(vec.at(0), std::out_of_range);
+  EXPECT_THROW(vec.at(3), std::out_of_range);
+  EXPECT_EQ(vec.at(4).value, 3);
+
+  std::vector<int> values;
+  for(const auto& item: vec)
+    values.push_back(item.value);
+  EXPECT_EQ(values, (std::vector<int>{1, 2, 3, 4}));
+  EXPECT_EQ((--vec.end())->value, 4);
+  EXPECT_EQ((----vec.end())->value, 3);
+  EXPECT_EQ((------vec.end())->value, 2);
+  reentrantTarget = nullptr;
+}
+
+TEST(segmented_vector_test_case, stable_address_test) {
+  custom::segmented_vector<int, 16, custom::allocator<int, 0>> vec;
+  vec.push_back(0);
+  const int* first = &vec.front();
+
+  for(int i = 1; i < 1000; ++i)
+    vec.push_back(i);
+
+  EXPECT_EQ(&vec.front(), first);
+  EXPECT_EQ(vec.size(), 1000);
+  EXPECT_EQ(vec.capacity(), 1008);
+  EXPECT_EQ(vec.segment_count(), 63);
+  EXPECT_EQ(vec.segment(1)[0], 16);
+  for(int i = 0; i < 1000; ++i)
+    ASSERT_EQ(vec[i], i);
+  EXPECT_TRUE(std::is_sorted(vec.begin(), vec.end()));
+  EXPECT_THROW(vec.at(1000), std::out_of_range);
+}
+
+TEST(segmented_vector_test_case, resize_test) {
+  custom::segmented_vector<std::string, 4> vec{"a", "b", "c", "d", "e"};
+  EXPECT_EQ(vec.capacity(), 8);
+
+  auto copy = vec;
+  vec.resize(2);
+  vec.shrink_to_fit();
+  EXPECT_EQ(vec.capacity(), 4);
+  EXPECT_EQ(vec.back(), "b");
+
+  vec.resize(9);
+  EXPECT_EQ(vec.capacity(), 12);
+  EXPECT_EQ(vec[8], "");
+  EXPECT_EQ(copy.size(), 5);
+  EXPECT_EQ(copy[4], "e");
+
+  vec.clear();
+  vec.shrink_to_fit();
+  EXPECT_EQ(vec.capacity(), 0);
+}
+
+TEST(vector_test_case, parallel_construct_test) {
+  constexpr size_t SIZE = 100000;
+  custom::parallel_policy policy(4, 1000);
+  EXPECT_EQ(policy.workers(SIZE), 4);
+  EXPECT_EQ(policy.workers(1500), 1);
+
+  custom::vector<std::string> vec(SIZE, "value", policy);
+  EXPECT_EQ(vec.size(), SIZE);
+  EXPECT_TRUE(std::all_of(vec.begin(), vec.end(), [](const std::string& s) { return s == "value"; }));
+
+  custom::vector<std::string> copy(vec, policy);
+  EXPECT_EQ(copy.size(), SIZE);
+  EXPECT_EQ(copy[SIZE - 1], "value");
+
+  copy.fill("other", policy);
+  EXPECT_EQ(std::count(copy.begin(), copy.end(), "other"), SIZE);
+
+  copy.resize(SIZE * 2, policy);
+  EXPECT_EQ(copy[SIZE * 2 - 1], "");
+  copy.resize(10, policy);
+  EXPECT_EQ(copy.size(), 10);
+  copy.clear(policy);
+  EXPECT_EQ(copy.size(), 0);
+}
+
+namespace {
+/**
+ * @brief Элемент, подсчитывающий живые экземпляры и бросающий исключение при копировании заданного значения.
+ */
+struct counted_t {
+  static std::atomic<int> alive;
+  int value;
+
+  counted_t(int value = 0) : value(value) {
+    ++alive;
+  }
+
+  counted_t(const counted_t& other) : value(other.value) {
+    if(value < 0)
+      throw std::runtime_error("copy failed");
+    ++alive;
+  }
+
+  ~counted_t() {
+    --alive;
+  }
+};
+
+std::atomic<int> counted_t::alive{0};
+}
+
+TEST(vector_test_case, parallel_construct_rollback_test) {
+  custom::vector<counted_t> vec(10000, counted_t(1));
+  vec[7777].value = -1;
+  int alive = counted_t::alive;
+
+  EXPECT_THROW(custom::vector<counted_t> copy(vec, custom::parallel_policy(4, 100)), std::runtime_error);
+  EXPECT_EQ(counted_t::alive, alive);
+}
+
+TEST(frame_pool_test_case, reuse_test) {
+  void* ptr = custom::frame_pool::allocate(100);
+  custom::frame_pool::deallocate(ptr, 100);
+
+  // Блок того же класса размера берется из списка свободных блоков потока.
+  EXPECT_EQ(custom::frame_pool::allocate(120), ptr);
+  custom::frame_pool::deallocate(ptr, 120);
+
+  void* large = custom::frame_pool::allocate(custom::frame_pool::MAX_CLASS_SIZE + 1);
+  EXPECT_NE(large, nullptr);
+  custom::frame_pool::deallocate(large, custom::frame_pool::MAX_CLASS_SIZE + 1);
+
+  auto freeSize = custom::getFreeHeapSize();
+  custom::frame_pool::trim();
+  EXPECT_GT(custom::getFreeHeapSize(), freeSize);
+}
+
+TEST(frame_pool_test_case, cache_limit_test) {
+  constexpr size_t COUNT = custom::frame_pool::MAX_CACHED_BLOCKS + 8;
+  custom::frame_pool::trim();
+  auto freeSize = custom::getFreeHeapSize();
+
+  std::vector<void*> blocks;
+  for(size_t i = 0; i < COUNT; ++i)
+    blocks.push_back(custom::frame_pool::allocate(100));
+  auto blockSize = (freeSize - custom::getFreeHeapSize()) / COUNT;
+
+  // Блоки сверх предела списка сразу возвращаются в кучу.
+  for(auto ptr: blocks)
+    custom::frame_pool::deallocate(ptr, 100);
+  EXPECT_EQ(custom::getFreeHeapSize(), freeSize - custom::frame_pool::MAX_CACHED_BLOCKS * blockSize);
+
+  custom::frame_pool::trim();
+  EXPECT_EQ(custom::getFreeHeapSize(), freeSize);
+}
+
+TEST(frame_pool_test_case, heap_file_test) {
+  std::string path = ::testing::TempDir() + "custom_frame_pool.bin";
+  std::remove(path.c_str());
+  custom::frame_pool::trim();
+
+  void* small = custom::frame_pool::allocate(100);
+  void* large = custom::frame_pool::allocate(custom::frame_pool::MAX_CLASS_SIZE + 1);
+  custom::frame_pool::deallocate(small, 100);
+  auto staticFreeSize = custom::getFreeHeapSize();
+
+  // Блоки кучи процесса, освобожденные при открытом файле кучи, возвращаются в кучу процесса.
+  ASSERT_TRUE(custom::openHeapFile(path.c_str(), 1 << 16));
+  auto fileFreeSize = custom::getFreeHeapSize();
+  custom::frame_pool::deallocate(large, custom::frame_pool::MAX_CLASS_SIZE + 1);
+  custom::frame_pool::trim();
+  EXPECT_EQ(custom::getFreeHeapSize(), fileFreeSize);
+
+  custom::closeHeapFile();
+  EXPECT_GT(custom::getFreeHeapSize(), staticFreeSize + custom::frame_pool::MAX_CLASS_SIZE);
+  std::remove(path.c_str());
+}
+
+namespace {
+/**
+ * @brief Объект, память под который выделяется из статических ячеек.
+ */
+struct pooled_t : custom::pooled_frame<custom::fixed_frame_pool<64, 2>> {
+  char data[48];
+};
+}
+
+TEST(frame_pool_test_case, fixed_slots_test) {
+  using pool_t = custom::fixed_frame_pool<64, 2>;
+  auto first = new pooled_t;
+  auto second = new pooled_t;
+  auto third = new pooled_t;
+
+  EXPECT_TRUE(pool_t::owns(first));
+  EXPECT_TRUE(pool_t::owns(second));
+  EXPECT_FALSE(pool_t::owns(third));
+
+  delete second;
+  auto fourth = new pooled_t;
+  EXPECT_EQ(fourth, second);
+
+  delete first;
+  delete third;
+  delete fourth;
+}
+
+namespace {
+/**
+ * @brief Запись, сохраняемая в файл как есть.
+ */
+struct record_t {
+  uint64_t id;
+  double value;
+  char tag[4];
+};
+}
+
+TEST(vector_io_test_case, save_map_load_test) {
+  constexpr size_t SIZE = 100000;
+  std::string path = ::testing::TempDir() + "custom_vector_io.bin";
+
+  custom::vector<record_t> vec;
+  vec.reserve(SIZE);
+  for(size_t i = 0; i < SIZE; ++i)
+    vec.push_back(record_t{i, i * 0.5, {'a', 'b', 'c', '\0'}});
+  ASSERT_TRUE(custom::saveVector(path.c_str(), vec));
+
+  custom::vector_view<record_t> view;
+  ASSERT_TRUE(view.open(path.c_str()));
+  ASSERT_EQ(view.size(), SIZE);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(view.data()) % alignof(record_t), 0);
+  EXPECT_EQ(view[SIZE - 1].id, SIZE - 1);
+  EXPECT_EQ(view.at(10).value, 5.0);
+  EXPECT_STREQ(view[7].tag, "abc");
+  EXPECT_THROW(view.at(SIZE), std::out_of_range);
+
+  EXPECT_TRUE(custom::loadVector(path.c_str(), vec));
+  EXPECT_EQ(vec.size(), SIZE);
+  EXPECT_EQ(vec[SIZE / 2].id, SIZE / 2);
+
+  // Файл другого типа элементов не открывается.
+  custom::vector_view<int> wrongType;
+  EXPECT_FALSE(wrongType.open(path.c_str()));
+  custom::vector<int> ints{1, 2, 3};
+  EXPECT_FALSE(custom::loadVector(path.c_str(), ints));
+  EXPECT_EQ(ints.size(), 3);
+
+  view.close();
+  std::remove(path.c_str());
+  EXPECT_FALSE(view.open(path.c_str()));
+  EXPECT_TRUE(view.empty());
+}
+
+TEST(vector_io_test_case, empty_vector_test) {
+  std::string path = ::testing::TempDir() + "custom_vector_io_empty.bin";
+  custom::vector<int> vec;
+  ASSERT_TRUE(custom::saveVector(path.c_str(), vec));
+
+  custom::vector_view<int> view;
+  ASSERT_TRUE(view.open(path.c_str()));
+  EXPECT_TRUE(view.empty());
+  EXPECT_EQ(view.begin(), view.end());
+
+  custom::vector<int> loaded{1, 2, 3};
+  EXPECT_TRUE(custom::loadVector(path.c_str(), loaded));
+  EXPECT_EQ(loaded.size(), 0);
+  std::remove(path.c_str());
+}
+
+TEST(vector_io_test_case, overwrite_mapped_test) {
+  constexpr size_t SIZE = 100000;
+  std::string path = ::testing::TempDir() + "custom_vector_io_overwrite.bin";
+  custom::vector<int> vec(SIZE, 7);
+  ASSERT_TRUE(custom::saveVector(path.c_str(), vec));
+
+  custom::vector_view<int> oldView;
+  ASSERT_TRUE(oldView.open(path.c_str()));
+
+  // Перезапись заменяет файл целиком: старое отображение остается читаемым.
+  custom::vector<int> small{1, 2, 3};
+  ASSERT_TRUE(custom::saveVector(path.c_str(), small));
+  EXPECT_EQ(oldView[SIZE - 1], 7);
+  EXPECT_NE(access((path + ".tmp").c_str(), F_OK), 0);
+
+  custom::vector_view<int> newView;
+  ASSERT_TRUE(newView.open(path.c_str()));
+  EXPECT_EQ(newView.size(), 3);
+  EXPECT_TRUE(custom::loadVector(path.c_str(), vec));
+  ASSERT_EQ(vec.size(), 3);
+  EXPECT_EQ(vec[2], 3);
+  std::remove(path.c_str());
+}
+
+TEST(heap_file_test_case, reopen_test) {
+  using vec_t = custom::vector<int, custom::allocator<int, 0>>;
+  std::string path = ::testing::TempDir() + "custom_heap_reopen.bin";
+  std::remove(path.c_str());
+
+  ASSERT_TRUE(custom::openHeapFile(path.c_str(), 1 << 20));
+  EXPECT_EQ(custom::getHeapSize(), 1 << 20);
+
+  auto vec = new(custom::malloc(sizeof(vec_t))) vec_t;
+  for(int i = 0; i < 1000; ++i)
+    vec->push_back(i);
+  custom::setHeapRoot(vec);
+  auto freeSize = custom::getFreeHeapSize();
+  custom::closeHeapFile();
+  EXPECT_EQ(custom::getHeapSize(), custom::HEAP_SIZE);
+
+  ASSERT_TRUE(custom::openHeapFile(path.c_str(), 0));
+  EXPECT_EQ(custom::getFreeHeapSize(), freeSize);
+  if(custom::isHeapRelocated()) {
+    custom::closeHeapFile();
+    std::remove(path.c_str());
+    GTEST_SKIP() << "Heap file could not be mapped at its original address";
+  }
+
+  auto restored = static_cast<vec_t*>(custom::getHeapRoot());
+  EXPECT_EQ(restored, vec);
+  ASSERT_EQ(restored->size(), 1000);
+  EXPECT_EQ((*restored)[999], 999);
+
+  restored->~vec_t();
+  custom::free(restored);
+
+  custom::closeHeapFile();
+  std::remove(path.c_str());
+}
+
+TEST(heap_file_test_case, free_static_block_test) {
+  std::string path = ::testing::TempDir() + "custom_heap_static_free.bin";
+  std::remove(path.c_str());
+
+  void* ptr = custom::malloc(256);
+  ASSERT_NE(ptr, nullptr);
+  auto staticFreeSize = custom::getFreeHeapSize();
+
+  // Блок кучи процесса, освобожденный при открытом файле, не попадает в файл кучи.
+  ASSERT_TRUE(custom::openHeapFile(path.c_str(), 1 << 16));
+  auto fileFreeSize = custom::getFreeHeapSize();
+  custom::free(ptr);
+  EXPECT_EQ(custom::getFreeHeapSize(), fileFreeSize);
+
+  int local = 0;
+  custom::free(&local);
+  EXPECT_EQ(custom::getFreeHeapSize(), fileFreeSize);
+
+  custom::closeHeapFile();
+  EXPECT_GT(custom::getFreeHeapSize(), staticFreeSize);
+  std::remove(path.c_str());
+}
+
+TEST(shm_heap_test_case, shared_vector_test) {
+  using vec_t = custom::vector<int, custom::shm_allocator<int>>;
+  const char* name = "/custom_shm_heap_test";
+  custom::shm_heap::remove(name);
+
+  // Два отображения одного сегмента имитируют два процесса.
+  custom::shm_heap writer;
+  custom::shm_heap reader;
+  ASSERT_TRUE(writer.open(name, 1 << 16));
+  ASSERT_TRUE(reader.open(name, 0));
+  writer.use();
+
+  auto vec = new(writer.malloc(sizeof(vec_t))) vec_t;
+  for(int i = 0; i < 100; ++i)
+    vec->push_back(i);
+  writer.setRoot(vec);
+
+  auto shared = static_cast<vec_t*>(reader.getRoot());
+  ASSERT_NE(shared, nullptr);
+  EXPECT_NE(static_cast<void*>(shared), static_cast<void*>(vec));
+  ASSERT_EQ(shared->size(), 100);
+  EXPECT_EQ((*shared)[99], 99);
+  EXPECT_TRUE(reader.contains(shared->data()));
+
+  vec->~vec_t();
+  writer.free(vec);
+  custom::shm_heap::remove(name);
+}
+
+TEST(shm_heap_test_case, owner_segment_test) {
+  using vec_t = custom::vector<int, custom::shm_allocator<int>>;
+  const char* first = "/custom_shm_heap_first";
+  const char* second = "/custom_shm_heap_second";
+  custom::shm_heap::remove(first);
+  custom::shm_heap::remove(second);
+
+  custom::shm_heap heap1;
+  custom::shm_heap heap2;
+  ASSERT_TRUE(heap1.open(first, 1 << 16));
+  ASSERT_TRUE(heap2.open(second, 1 << 16));
+
+  // Вектор в первом сегменте выделяет и освобождает память в нем, какая бы куча ни была текущей.
+  auto vec = new(heap1.malloc(sizeof(vec_t))) vec_t;
+  auto freeSize1 = heap1.getFreeSize();
+  auto freeSize2 = heap2.getFreeSize();
+  heap2.use();
+  vec->reserve(32);
+  for(int i = 0; i < 100; ++i)
+    vec->push_back(i);
+  EXPECT_TRUE(heap1.contains(vec->data()));
+  EXPECT_EQ(heap2.getFreeSize(), freeSize2);
+
+  vec->clear();
+  vec->shrink_to_fit();
+  EXPECT_EQ(heap1.getFreeSize(), freeSize1);
+  EXPECT_EQ(heap2.getFreeSize(), freeSize2);
+  EXPECT_EQ(custom::shm_heap::owner(vec), &heap1);
+
+  vec->~vec_t();
+  heap1.free(vec);
+  custom::shm_heap::remove(first);
+  custom::shm_heap::remove(second);
+}
+
+TEST(shm_heap_test_case, current_heap_threads_test) {
+  const char* name = "/custom_shm_heap_current";
+  custom::shm_heap::remove(name);
+  custom::shm_heap fixed;
+  ASSERT_TRUE(fixed.open(name, 1 << 16));
+  std::atomic<bool> done(false);
+
+  // Закрытие кучи в другом потоке не оставляет current() указывающей на нее.
+  std::thread closer([name, &done]() {
+    for(int i = 0; i < 200; ++i) {
+      custom::shm_heap heap;
+      if(heap.open(name, 1 << 16)) {
+        heap.use();
+        heap.close();
+      }
+    }
+    done = true;
+  });
+  while(!done) {
+    fixed.use();
+    custom::shm_heap::current();
+  }
+  closer.join();
+
+  fixed.use();
+  EXPECT_EQ(custom::shm_heap::current(), &fixed);
+  fixed.close();
+  EXPECT_EQ(custom::shm_heap::current(), nullptr);
+  custom::shm_heap::remove(name);
+}
+
+TEST(shm_heap_test_case, dead_creator_test) {
+  const char* name = "/custom_shm_heap_dead";
+  custom::shm_heap::remove(name);
+
+  // Сегмент, размер которого задан, но разметка не завершена, как после аварии создателя.
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(ftruncate(fd, 1 << 16), 0);
+  ::close(fd);
+
+  custom::shm_heap heap;
+  EXPECT_FALSE(heap.open(name, 0, 100));
+  custom::shm_heap::remove(name);
+}
+
 int main(int argc, char *argv[]) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();